@@ -0,0 +1,78 @@
+#ifndef API_JSON_HPP
+#define API_JSON_HPP
+
+#include <string>
+#include <vector>
+#include <sstream>
+#include "WeatherEngine.hpp"
+
+// Response bodies shared by the server and the benchmarks.
+
+namespace ApiJson {
+
+    // Full dashboard payload served by /data.
+    inline std::string cityData(WeatherEngine& engine, const City& c) {
+        std::stringstream json;
+        json << "{";
+        json << "\"city\": \"" << c.name << "\",";
+        json << "\"lat\": " << c.lat << ",";
+        json << "\"lon\": " << c.lon << ",";
+        json << "\"current\": {";
+        json << "\"temperature_2d\": " << c.temp << ",";
+        json << "\"wind_speed_10m\": " << c.wind << ",";
+        json << "\"relative_humidity_2d\": " << c.humidity << ",";
+        json << "\"rain\": 0,";
+        json << "\"aqi\": 45,";
+        json << "\"wind_dir\": " << c.wind_dir << ",";
+        json << "\"condition\": \"" << c.condition << "\"";
+        json << "},";
+
+        auto lifestyle = engine.calculateLifestyleIndices(c);
+        json << "\"lifestyle\": {";
+        json << "\"drone\": \"" << lifestyle["Drone"] << "\",";
+        json << "\"running\": \"" << lifestyle["Running"] << "\",";
+        json << "\"bbq\": \"" << lifestyle["BBQ"] << "\"";
+        json << "},";
+
+        json << "\"hourly\": ["; for (size_t i = 0; i < c.hourlyData.size(); i++) json << c.hourlyData[i] << (i < c.hourlyData.size() - 1 ? "," : ""); json << "],";
+        json << "\"weekly\": ["; for (size_t i = 0; i < c.weeklyData.size(); i++) json << c.weeklyData[i] << (i < c.weeklyData.size() - 1 ? "," : ""); json << "],";
+        json << "\"monthly\": ["; for (size_t i = 0; i < c.monthlyData.size(); i++) json << c.monthlyData[i] << (i < c.monthlyData.size() - 1 ? "," : ""); json << "],";
+        json << "\"yearly\": ["; for (size_t i = 0; i < c.yearlyData.size(); i++) json << c.yearlyData[i] << (i < c.yearlyData.size() - 1 ? "," : ""); json << "],";
+
+        json << "\"forecast\": [";
+        for (size_t i = 0; i < c.tenDayForecast.size(); i++) {
+            json << "{ \"day\": \"" << c.tenDayForecast[i].dayName
+                << "\", \"high\": " << c.tenDayForecast[i].high
+                << ", \"low\": " << c.tenDayForecast[i].low
+                << ", \"rain_prob\": " << c.tenDayForecast[i].rain_prob
+                << ", \"cond\": \"" << c.tenDayForecast[i].condition << "\" }";
+            if (i < c.tenDayForecast.size() - 1) json << ",";
+        }
+        json << "],";
+
+        json << "\"alerts\": [";
+        for (size_t i = 0; i < c.activeAlerts.size(); i++) {
+            json << "\"" << c.activeAlerts[i] << "\"" << (i < c.activeAlerts.size() - 1 ? "," : "");
+        }
+        json << "],";
+
+        std::vector<std::string> neighbors = engine.getNeighbors(c.name);
+        json << "\"neighbors\": [";
+        for (size_t i = 0; i < neighbors.size(); i++) {
+            json << "\"" << neighbors[i] << "\"" << (i < neighbors.size() - 1 ? "," : "");
+        }
+        json << "],";
+
+        std::vector<City> hottest = engine.getHottestCities(5);
+        json << "\"hottest_cities\": [";
+        for (size_t i = 0; i < hottest.size(); i++) {
+            json << "{\"name\": \"" << hottest[i].name << "\", \"temp\": " << hottest[i].temp << "}" << (i < hottest.size() - 1 ? "," : "");
+        }
+        json << "]";
+
+        json << "}";
+        return json.str();
+    }
+}
+
+#endif
@@ -0,0 +1,402 @@
+#ifndef FIELD_HPP
+#define FIELD_HPP
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <functional>
+#include <condition_variable>
+#include <deque>
+#include <unordered_map>
+#include <algorithm>
+#include <sstream>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include "WeatherEngine.hpp"
+#include "Tracing.hpp"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define FIELD_USE_SSE 1
+#endif
+
+// Gridded weather field for the map overlay, interpolated from the city
+// readings with inverse distance weighting (power 2) inside a search radius.
+// Cells with no city in range are NaN, which the overlay draws transparent.
+
+namespace Field {
+
+    struct Request {
+        std::string metric = "temp";
+        double west = 60.0, south = 23.0, east = 78.0, north = 37.5; // bbox, degrees
+        int resolution = 64;
+    };
+
+    struct Grid {
+        int width = 0, height = 0;
+        double west = 0, south = 0, east = 0, north = 0;
+        uint64_t version = 0;
+        std::vector<float> values; // row-major, first row is the northern edge
+    };
+
+    static const int kMaxResolution = 512;
+    static const float kSearchRadiusDeg = 4.0f;
+
+    inline bool isSupportedMetric(const std::string& metric) {
+        return metric == "temp" || metric == "humidity" || metric == "wind";
+    }
+
+    // Parses "west,south,east,north" (Leaflet's toBBoxString order).
+    inline bool parseBbox(const std::string& text, Request& req) {
+        double w, s, e, n;
+        if (sscanf(text.c_str(), "%lf,%lf,%lf,%lf", &w, &s, &e, &n) != 4) return false;
+        if (!(w < e) || !(s < n) || s < -90 || n > 90 || w < -180 || e > 180) return false;
+        req.west = w; req.south = s; req.east = e; req.north = n;
+        return true;
+    }
+
+    // City readings as structure-of-arrays, sorted by latitude so each row
+    // only looks at the band of cities within the search radius.
+    struct Samples {
+        std::vector<float> lat, lon, value;
+    };
+
+    // Only position and the one metric are read while engineMutex is held;
+    // sorting and the SoA split happen after it is released.
+    inline Samples collectSamples(WeatherEngine& engine, const std::string& metric) {
+        struct Reading { float lat, lon, value; };
+        const bool humidity = metric == "humidity", wind = metric == "wind";
+        std::vector<Reading> live;
+        engine.forEachCity([&](const City& c) {
+            if (c.lastUpdated == 0) return;
+            int value = humidity ? c.humidity : wind ? c.wind : c.temp;
+            live.push_back({ (float)c.lat, (float)c.lon, (float)value });
+        });
+        std::sort(live.begin(), live.end(), [](const Reading& a, const Reading& b) { return a.lat < b.lat; });
+
+        Samples s;
+        s.lat.reserve(live.size()); s.lon.reserve(live.size()); s.value.reserve(live.size());
+        for (const Reading& r : live) {
+            s.lat.push_back(r.lat);
+            s.lon.push_back(r.lon);
+            s.value.push_back(r.value);
+        }
+        return s;
+    }
+
+    // Fills one output row. Candidates are copied into padded SoA buffers so
+    // the inner loop runs four cities per step with no tail; padding sits far
+    // outside the radius and is masked off like any other distant city.
+    inline void interpolateRow(const Samples& samples, float rowLat, double west, double cellWidth, int width, float* out) {
+        const float radius = kSearchRadiusDeg;
+        const float radius2 = radius * radius;
+        const float cosLat = std::cos(rowLat * 3.14159265f / 180.0f);
+
+        auto first = std::lower_bound(samples.lat.begin(), samples.lat.end(), rowLat - radius) - samples.lat.begin();
+        auto last = std::upper_bound(samples.lat.begin(), samples.lat.end(), rowLat + radius) - samples.lat.begin();
+        size_t count = (size_t)(last - first);
+        if (count == 0) {
+            for (int x = 0; x < width; x++) out[x] = std::numeric_limits<float>::quiet_NaN();
+            return;
+        }
+
+        size_t padded = (count + 3) & ~(size_t)3;
+        std::vector<float> lat(padded, 1e6f), lon(padded, 1e6f), value(padded, 0.0f);
+        for (size_t i = 0; i < count; i++) {
+            lat[i] = samples.lat[first + i];
+            lon[i] = samples.lon[first + i];
+            value[i] = samples.value[first + i];
+        }
+
+        for (int x = 0; x < width; x++) {
+            float cellLon = (float)(west + (x + 0.5) * cellWidth);
+            float weightSum = 0, valueSum = 0;
+#ifdef FIELD_USE_SSE
+            const __m128 vLon = _mm_set1_ps(cellLon), vLat = _mm_set1_ps(rowLat), vCos = _mm_set1_ps(cosLat);
+            const __m128 vRadius2 = _mm_set1_ps(radius2), vEps = _mm_set1_ps(1e-6f), vOne = _mm_set1_ps(1.0f);
+            __m128 wAcc = _mm_setzero_ps(), vAcc = _mm_setzero_ps();
+            for (size_t i = 0; i < padded; i += 4) {
+                __m128 dx = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&lon[i]), vLon), vCos);
+                __m128 dy = _mm_sub_ps(_mm_loadu_ps(&lat[i]), vLat);
+                __m128 d2 = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+                __m128 inRange = _mm_cmplt_ps(d2, vRadius2);
+                __m128 w = _mm_and_ps(inRange, _mm_div_ps(vOne, _mm_max_ps(d2, vEps)));
+                wAcc = _mm_add_ps(wAcc, w);
+                vAcc = _mm_add_ps(vAcc, _mm_mul_ps(w, _mm_loadu_ps(&value[i])));
+            }
+            float wLanes[4], vLanes[4];
+            _mm_storeu_ps(wLanes, wAcc);
+            _mm_storeu_ps(vLanes, vAcc);
+            weightSum = wLanes[0] + wLanes[1] + wLanes[2] + wLanes[3];
+            valueSum = vLanes[0] + vLanes[1] + vLanes[2] + vLanes[3];
+#else
+            for (size_t i = 0; i < padded; i++) {
+                float dx = (lon[i] - cellLon) * cosLat, dy = lat[i] - rowLat;
+                float d2 = dx * dx + dy * dy;
+                if (d2 >= radius2) continue;
+                float w = 1.0f / std::max(d2, 1e-6f);
+                weightSum += w;
+                valueSum += w * value[i];
+            }
+#endif
+            out[x] = weightSum > 0 ? valueSum / weightSum : std::numeric_limits<float>::quiet_NaN();
+        }
+    }
+
+    // A few process-wide helper threads for the row bands of large grids.
+    // The requesting worker always works through the bands itself, so the
+    // helpers only add parallelism: concurrent builds share these threads
+    // instead of each starting their own, and a busy pool never blocks one.
+    class RowPool {
+    public:
+        // Deliberately leaked: the detached helpers wait on poolMutex and
+        // poolReady for the life of the process, so they must never be
+        // destroyed by static teardown at exit.
+        static RowPool& instance() {
+            static RowPool* pool = new RowPool(std::min(4u, std::max(1u, std::thread::hardware_concurrency() / 2)));
+            return *pool;
+        }
+
+        // Calls fill(begin, end) over [0, rows) in bands of bandRows; returns
+        // once every band is done.
+        void run(int rows, int bandRows, std::function<void(int, int)> fill) {
+            auto batch = std::make_shared<Batch>();
+            batch->rows = rows;
+            batch->bandRows = bandRows;
+            batch->bands = (rows + bandRows - 1) / bandRows;
+            batch->fill = std::move(fill);
+            if (batch->bands > 1) {
+                {
+                    std::lock_guard<std::mutex> lock(poolMutex);
+                    for (size_t i = 0; i < helperCount && (int)i < batch->bands - 1; i++) pending.push_back(batch);
+                }
+                poolReady.notify_all();
+            }
+
+            work(*batch);
+            std::unique_lock<std::mutex> lock(batch->doneMutex);
+            batch->doneReady.wait(lock, [&]() { return batch->finished == batch->bands; });
+        }
+
+    private:
+        struct Batch {
+            int rows = 0, bandRows = 1, bands = 0;
+            std::function<void(int, int)> fill;
+            std::atomic<int> next{ 0 };
+            int finished = 0; // guarded by doneMutex
+            std::mutex doneMutex;
+            std::condition_variable doneReady;
+        };
+
+        std::mutex poolMutex;
+        std::condition_variable poolReady;
+        std::deque<std::shared_ptr<Batch>> pending;
+        size_t helperCount;
+
+        explicit RowPool(size_t helpers) : helperCount(helpers) {
+            for (size_t i = 0; i < helpers; i++) {
+                std::thread(&RowPool::helperLoop, this).detach();
+            }
+        }
+
+        // Claims bands until none are left. A helper that picks up a batch
+        // after it has finished claims nothing and never touches fill.
+        static void work(Batch& batch) {
+            int done = 0;
+            for (int band; (band = batch.next.fetch_add(1, std::memory_order_relaxed)) < batch.bands; done++) {
+                int begin = band * batch.bandRows;
+                batch.fill(begin, std::min(batch.rows, begin + batch.bandRows));
+            }
+            if (done == 0) return;
+            std::lock_guard<std::mutex> lock(batch.doneMutex);
+            batch.finished += done;
+            if (batch.finished == batch.bands) batch.doneReady.notify_all();
+        }
+
+        void helperLoop() {
+            while (true) {
+                std::shared_ptr<Batch> batch;
+                {
+                    std::unique_lock<std::mutex> lock(poolMutex);
+                    poolReady.wait(lock, [this]() { return !pending.empty(); });
+                    batch = pending.front();
+                    pending.pop_front();
+                }
+                work(*batch);
+            }
+        }
+    };
+
+    // Rows are independent; large grids are split into bands on the RowPool.
+    inline std::shared_ptr<Grid> build(const Samples& samples, const Request& req, uint64_t version) {
+        TRACE_SCOPE("buildField", req.metric);
+        auto grid = std::make_shared<Grid>();
+        grid->width = grid->height = req.resolution;
+        grid->west = req.west; grid->south = req.south; grid->east = req.east; grid->north = req.north;
+        grid->version = version;
+        grid->values.assign((size_t)grid->width * grid->height, 0.0f);
+
+        double cellWidth = (req.east - req.west) / grid->width;
+        double cellHeight = (req.north - req.south) / grid->height;
+
+        auto fillRows = [&](int rowBegin, int rowEnd) {
+            for (int y = rowBegin; y < rowEnd; y++) {
+                float rowLat = (float)(req.north - (y + 0.5) * cellHeight);
+                interpolateRow(samples, rowLat, req.west, cellWidth, grid->width, &grid->values[(size_t)y * grid->width]);
+            }
+        };
+
+        if (grid->values.size() < 4096) fillRows(0, grid->height);
+        else RowPool::instance().run(grid->height, std::max(1, 4096 / grid->width), fillRows);
+        return grid;
+    }
+
+    // Snaps the bbox outward to a fixed grid of square tiles, so pans and
+    // small zooms inside the same tiles share one cached grid. The tile edge
+    // is a power of two in degrees (1/64 to 64), the smallest that is at
+    // least a quarter of the requested span. The grid covers the snapped bbox.
+    inline Request snapToTiles(const Request& req) {
+        double span = std::max(req.east - req.west, req.north - req.south);
+        double tile = 1.0 / 64;
+        while (tile * 4 < span && tile < 64) tile *= 2;
+
+        Request snapped = req;
+        snapped.west = std::max(-180.0, std::floor(req.west / tile) * tile);
+        snapped.south = std::max(-90.0, std::floor(req.south / tile) * tile);
+        snapped.east = std::min(180.0, std::ceil(req.east / tile) * tile);
+        snapped.north = std::min(90.0, std::ceil(req.north / tile) * tile);
+        return snapped;
+    }
+
+    // Grids for tile-snapped requests. A grid is reused while the engine's
+    // data version is unchanged, and for a short grace period after it
+    // changes, so a run of background refreshes rebuilds each key at most
+    // once per grace period. Concurrent misses on one key share one build.
+    // Oldest entries are evicted first.
+    class TileCache {
+    public:
+        explicit TileCache(size_t capacity = 64, std::chrono::milliseconds grace = std::chrono::milliseconds(10000))
+            : maxEntries(capacity), rebuildGrace(grace) {}
+
+        std::shared_ptr<const Grid> get(WeatherEngine& engine, const Request& requested) {
+            Request req = snapToTiles(requested);
+            char key[128];
+            snprintf(key, sizeof(key), "%s|%.6f,%.6f,%.6f,%.6f|%d", req.metric.c_str(),
+                req.west, req.south, req.east, req.north, req.resolution);
+
+            uint64_t version = engine.getDataVersion();
+            auto now = std::chrono::steady_clock::now();
+            std::unique_ptr<std::promise<std::shared_ptr<const Grid>>> result;
+            std::shared_future<std::shared_ptr<const Grid>> inProgress;
+            {
+                std::lock_guard<std::mutex> lock(cacheMutex);
+                auto it = tiles.find(key);
+                if (it != tiles.end() && (it->second.grid->version == version || now - it->second.built < rebuildGrace)) {
+                    Metrics::registry().fieldCache.record(Metrics::CacheHit);
+                    return it->second.grid;
+                }
+                auto flight = inFlight.find(key);
+                if (flight != inFlight.end()) inProgress = flight->second;
+                else {
+                    result.reset(new std::promise<std::shared_ptr<const Grid>>());
+                    inFlight.emplace(key, result->get_future().share());
+                }
+            }
+            if (inProgress.valid()) {
+                // Another worker is building this key; wait for its grid.
+                Metrics::registry().fieldCache.record(Metrics::CacheCoalesced);
+                return inProgress.get();
+            }
+
+            Metrics::registry().fieldCache.record(Metrics::CacheMiss);
+            std::shared_ptr<const Grid> grid;
+            try {
+                grid = build(collectSamples(engine, req.metric), req, version);
+            }
+            catch (...) {
+                {
+                    std::lock_guard<std::mutex> lock(cacheMutex);
+                    inFlight.erase(key);
+                }
+                result->set_exception(std::current_exception());
+                throw;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(cacheMutex);
+                inFlight.erase(key);
+                auto inserted = tiles.insert({ key, { grid, now } });
+                if (inserted.second) order.push_back(key);
+                else inserted.first->second = { grid, now };
+                while (order.size() > maxEntries) {
+                    tiles.erase(order.front());
+                    order.pop_front();
+                }
+            }
+            result->set_value(grid);
+            return grid;
+        }
+
+    private:
+        struct Entry {
+            std::shared_ptr<const Grid> grid;
+            std::chrono::steady_clock::time_point built;
+        };
+
+        std::mutex cacheMutex;
+        std::unordered_map<std::string, Entry> tiles;
+        std::unordered_map<std::string, std::shared_future<std::shared_ptr<const Grid>>> inFlight;
+        std::deque<std::string> order;
+        size_t maxEntries;
+        std::chrono::milliseconds rebuildGrace;
+    };
+
+    inline std::string toJson(const Grid& g, const std::string& metric) {
+        std::stringstream json;
+        json.setf(std::ios::fixed);
+        json.precision(1);
+        json << "{ \"metric\": \"" << metric << "\", \"width\": " << g.width << ", \"height\": " << g.height
+            << ", \"version\": " << g.version << ", ";
+        json.precision(5);
+        json << "\"bbox\": [" << g.west << "," << g.south << "," << g.east << "," << g.north << "], ";
+        json.precision(1);
+        json << "\"values\": [";
+        for (size_t i = 0; i < g.values.size(); i++) {
+            if (i) json << ",";
+            if (std::isnan(g.values[i])) json << "null";
+            else json << g.values[i];
+        }
+        json << "] }";
+        return json.str();
+    }
+
+    // Raw little-endian Float32 cells, row-major from the northern edge; the
+    // shape travels in X-Field-* headers.
+    inline std::string toFloat32(const Grid& g) {
+        std::string bytes(g.values.size() * sizeof(float), '\0');
+        memcpy(&bytes[0], g.values.data(), bytes.size());
+        return bytes;
+    }
+
+    inline std::string float32Headers(const Grid& g) {
+        std::stringstream h;
+        h.precision(10);
+        h << "X-Field-Width: " << g.width << "\r\n";
+        h << "X-Field-Height: " << g.height << "\r\n";
+        h << "X-Field-Bbox: " << g.west << "," << g.south << "," << g.east << "," << g.north << "\r\n";
+        h << "X-Field-Version: " << g.version << "\r\n";
+        h << "Access-Control-Expose-Headers: X-Field-Width, X-Field-Height, X-Field-Bbox, X-Field-Version\r\n";
+        return h.str();
+    }
+}
+
+#endif
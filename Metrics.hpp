@@ -0,0 +1,388 @@
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <memory>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <sstream>
+#include <fstream>
+#include <iomanip>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <ctime>
+#include <functional>
+
+namespace Metrics {
+
+    inline uint64_t nowMicros() {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // --- LATENCY HISTOGRAM ---
+    // HDR-style log-linear buckets over microseconds: exact below 8us, then
+    // 8 sub-buckets per power of two (~12% relative error), up to ~134s.
+    // Recording is a single relaxed atomic increment.
+    class LatencyHistogram {
+    public:
+        static const int kSubBuckets = 8;
+        static const int kBuckets = 200;
+
+        void record(uint64_t micros) {
+            buckets[bucketFor(micros)].fetch_add(1, std::memory_order_relaxed);
+            count.fetch_add(1, std::memory_order_relaxed);
+            sumMicros.fetch_add(micros, std::memory_order_relaxed);
+        }
+
+        uint64_t totalCount() const { return count.load(std::memory_order_relaxed); }
+
+        // Value at the given quantile (0..1), reported as the bucket's upper bound.
+        uint64_t quantile(double q) const {
+            uint64_t snapshot[kBuckets];
+            uint64_t total = 0;
+            for (int i = 0; i < kBuckets; i++) { snapshot[i] = buckets[i].load(std::memory_order_relaxed); total += snapshot[i]; }
+            if (total == 0) return 0;
+            uint64_t rank = (uint64_t)(q * (double)total);
+            if (rank >= total) rank = total - 1;
+            uint64_t seen = 0;
+            for (int i = 0; i < kBuckets; i++) {
+                seen += snapshot[i];
+                if (seen > rank) return upperBound(i);
+            }
+            return upperBound(kBuckets - 1);
+        }
+
+        // Prometheus histogram folded out of the fine buckets, plus p50/p99/p999
+        // gauges from the fine buckets. For each target bound the `le` emitted
+        // is the upper edge of the last fine bucket at or below it (e.g. 500us
+        // becomes le="0.000479"), so every count is exact rather than rounded.
+        void writePrometheus(std::ostream& out, const std::string& name, const std::string& labels) const {
+            static const double targets[] = { 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10 };
+            std::string sep = labels.empty() ? "" : ",";
+            uint64_t cumulative = 0;
+            int i = 0;
+            for (double target : targets) {
+                uint64_t limit = (uint64_t)(target * 1e6);
+                while (i < kBuckets && upperBound(i) <= limit) cumulative += buckets[i++].load(std::memory_order_relaxed);
+                out << name << "_bucket{" << labels << sep << "le=\"" << formatSeconds(upperBound(i - 1)) << "\"} " << cumulative << "\n";
+            }
+            uint64_t total = count.load(std::memory_order_relaxed);
+            out << name << "_bucket{" << labels << sep << "le=\"+Inf\"} " << total << "\n";
+            out << name << "_sum{" << labels << "} " << (double)sumMicros.load(std::memory_order_relaxed) / 1e6 << "\n";
+            out << name << "_count{" << labels << "} " << total << "\n";
+        }
+
+        void writeQuantiles(std::ostream& out, const std::string& name, const std::string& labels) const {
+            std::string sep = labels.empty() ? "" : ",";
+            out << name << "{" << labels << sep << "quantile=\"0.5\"} " << quantile(0.5) / 1e6 << "\n";
+            out << name << "{" << labels << sep << "quantile=\"0.99\"} " << quantile(0.99) / 1e6 << "\n";
+            out << name << "{" << labels << sep << "quantile=\"0.999\"} " << quantile(0.999) / 1e6 << "\n";
+        }
+
+        // Whole microseconds as decimal seconds, without float rounding.
+        static std::string formatSeconds(uint64_t micros) {
+            char buf[32];
+            snprintf(buf, sizeof(buf), "%llu.%06llu", (unsigned long long)(micros / 1000000), (unsigned long long)(micros % 1000000));
+            std::string text = buf;
+            text.erase(text.find_last_not_of('0') + 1);
+            if (text.back() == '.') text.pop_back();
+            return text;
+        }
+
+        static int bucketFor(uint64_t v) {
+            if (v < kSubBuckets) return (int)v;
+            int msb = 3;
+            while (msb < 63 && (v >> (msb + 1)) != 0) msb++;
+            int shift = msb - 3;
+            int index = (shift + 1) * kSubBuckets + (int)((v >> shift) & (kSubBuckets - 1));
+            return index < kBuckets ? index : kBuckets - 1;
+        }
+
+        static uint64_t upperBound(int index) {
+            if (index < kSubBuckets) return (uint64_t)index;
+            int shift = index / kSubBuckets - 1;
+            uint64_t sub = (uint64_t)(index % kSubBuckets);
+            return ((kSubBuckets + sub + 1) << shift) - 1;
+        }
+
+    private:
+        std::atomic<uint64_t> buckets[kBuckets] = {};
+        std::atomic<uint64_t> count{ 0 };
+        std::atomic<uint64_t> sumMicros{ 0 };
+    };
+
+    // --- ACCESS LOG ---
+
+    struct AccessRecord {
+        int64_t unixTime = 0;
+        uint64_t completedMicros = 0; // steady clock, orders records across shards
+        char route[16] = { 0 };
+        char city[48] = { 0 };
+        int status = 0;
+        uint64_t bytes = 0;
+        uint64_t latencyMicros = 0;
+    };
+
+    // Bounded lock-free ring (Vyukov sequence slots). Any number of request
+    // threads push; the single drain thread pops. A full ring drops the new
+    // record instead of blocking the request path.
+    class AccessRing {
+    public:
+        static const size_t kCapacity = 1024; // power of two
+
+        AccessRing() {
+            for (size_t i = 0; i < kCapacity; i++) slots[i].seq.store(i, std::memory_order_relaxed);
+        }
+
+        bool push(const AccessRecord& rec) {
+            size_t pos = head.load(std::memory_order_relaxed);
+            for (;;) {
+                Slot& slot = slots[pos & (kCapacity - 1)];
+                size_t seq = slot.seq.load(std::memory_order_acquire);
+                intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+                if (diff == 0) {
+                    if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        slot.rec = rec;
+                        slot.seq.store(pos + 1, std::memory_order_release);
+                        return true;
+                    }
+                }
+                else if (diff < 0) {
+                    return false;
+                }
+                else {
+                    pos = head.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        bool pop(AccessRecord& out) {
+            Slot& slot = slots[tail & (kCapacity - 1)];
+            size_t seq = slot.seq.load(std::memory_order_acquire);
+            if ((intptr_t)seq - (intptr_t)(tail + 1) < 0) return false;
+            out = slot.rec;
+            slot.seq.store(tail + kCapacity, std::memory_order_release);
+            tail++;
+            return true;
+        }
+
+    private:
+        struct Slot {
+            std::atomic<size_t> seq;
+            AccessRecord rec;
+        };
+        Slot slots[kCapacity];
+        alignas(64) std::atomic<size_t> head{ 0 };
+        alignas(64) size_t tail = 0;
+    };
+
+    // Records are spread over a few rings keyed by thread id so concurrent
+    // handlers rarely contend on the same head counter, then drained to disk
+    // by one background thread.
+    class AccessLog {
+    public:
+        static const size_t kShards = 8;
+
+        static AccessLog& instance() {
+            static AccessLog log;
+            return log;
+        }
+
+        void record(const std::string& route, const std::string& city, int status, uint64_t bytes, uint64_t latencyMicros) {
+            AccessRecord rec;
+            rec.unixTime = (int64_t)std::time(nullptr);
+            rec.completedMicros = nowMicros();
+            strncpy(rec.route, route.c_str(), sizeof(rec.route) - 1);
+            strncpy(rec.city, city.c_str(), sizeof(rec.city) - 1);
+            rec.status = status;
+            rec.bytes = bytes;
+            rec.latencyMicros = latencyMicros;
+
+            static thread_local size_t shard = std::hash<std::thread::id>{}(std::this_thread::get_id()) % kShards;
+            if (!rings[shard].push(rec)) dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // Starts the background writer; safe to call once at startup.
+        void start(const std::string& path, std::chrono::milliseconds interval = std::chrono::milliseconds(250)) {
+            bool expected = false;
+            if (!running.compare_exchange_strong(expected, true)) return;
+            std::thread([this, path, interval]() {
+                std::ofstream file(path, std::ios::app);
+                while (true) {
+                    std::this_thread::sleep_for(interval);
+                    if (drainTo(file) > 0) file.flush();
+                }
+            }).detach();
+        }
+
+        uint64_t droppedCount() const { return dropped.load(std::memory_order_relaxed); }
+        uint64_t writtenCount() const { return written.load(std::memory_order_relaxed); }
+
+    private:
+        std::unique_ptr<AccessRing[]> rings{ new AccessRing[kShards] };
+        std::atomic<bool> running{ false };
+        std::atomic<uint64_t> dropped{ 0 };
+        std::atomic<uint64_t> written{ 0 };
+
+        std::vector<AccessRecord> batch;
+
+        // Each ring is FIFO on its own, so the batch is merged by completion
+        // time before writing; lines within one drain come out in order.
+        size_t drainTo(std::ostream& out) {
+            batch.clear();
+            AccessRecord rec;
+            for (size_t s = 0; s < kShards; s++) {
+                while (rings[s].pop(rec)) batch.push_back(rec);
+            }
+            std::stable_sort(batch.begin(), batch.end(), [](const AccessRecord& a, const AccessRecord& b) {
+                return a.completedMicros < b.completedMicros;
+            });
+            for (const AccessRecord& r : batch) {
+                char when[32];
+                std::time_t t = (std::time_t)r.unixTime;
+                std::tm* tmv = std::gmtime(&t);
+                if (!tmv || !std::strftime(when, sizeof(when), "%Y-%m-%dT%H:%M:%SZ", tmv)) when[0] = '\0';
+                out << when << " " << r.route << " city=" << (r.city[0] ? r.city : "-")
+                    << " status=" << r.status << " bytes=" << r.bytes << " latency_us=" << r.latencyMicros << "\n";
+            }
+            written.fetch_add(batch.size(), std::memory_order_relaxed);
+            return batch.size();
+        }
+    };
+
+    // --- REGISTRY ---
+
+    // Routes are fixed, so every metric is preallocated and lock-free to update.
+    enum Route { RouteIndex, RouteNews, RouteCities, RoutePredict, RouteRoute, RouteData, RouteMetrics, RouteTrace, RouteField, RouteOther, RouteCount };
+
+    inline const char* routeName(Route r) {
+        static const char* names[] = { "/", "/news", "/cities", "/predict", "/route", "/data", "/metrics", "/trace", "/field", "other" };
+        return names[r];
+    }
+
+    // Coalesced: a miss that waited on another request's in-flight build.
+    enum CacheResult { CacheHit, CacheMiss, CacheRevalidated, CacheStale, CacheCoalesced, CacheResultCount };
+
+    struct CacheStats {
+        std::atomic<uint64_t> results[CacheResultCount] = {};
+        void record(CacheResult r) { results[r].fetch_add(1, std::memory_order_relaxed); }
+    };
+
+    struct Registry {
+        LatencyHistogram routeLatency[RouteCount];
+        std::atomic<uint64_t> routeStatus[RouteCount][6] = {}; // by status class 0xx..5xx
+        LatencyHistogram upstreamLatency;
+        std::atomic<uint64_t> upstreamErrors{ 0 };
+        CacheStats staticCache;
+        CacheStats cityCache;
+        CacheStats fieldCache;
+        std::atomic<int64_t> activeConnections{ 0 };
+
+        // Admission control (see WorkerPool.hpp)
+        std::atomic<int64_t> queueDepth{ 0 };
+        std::atomic<uint64_t> shedTotal{ 0 };
+        std::atomic<uint64_t> queueExpired{ 0 };
+        std::atomic<uint64_t> deadlineExceeded{ 0 };
+        std::atomic<uint64_t> degradedServed{ 0 };
+    };
+
+    inline Registry& registry() {
+        static Registry r;
+        return r;
+    }
+
+    inline void recordRequest(Route route, const std::string& city, int status, uint64_t bytes, uint64_t latencyMicros) {
+        Registry& r = registry();
+        r.routeLatency[route].record(latencyMicros);
+        int statusClass = (status >= 0 && status < 600) ? status / 100 : 0;
+        r.routeStatus[route][statusClass].fetch_add(1, std::memory_order_relaxed);
+        AccessLog::instance().record(routeName(route), city, status, bytes, latencyMicros);
+    }
+
+    // RAII gauge for the number of connections currently being handled.
+    struct ConnectionScope {
+        ConnectionScope() { registry().activeConnections.fetch_add(1, std::memory_order_relaxed); }
+        ~ConnectionScope() { registry().activeConnections.fetch_sub(1, std::memory_order_relaxed); }
+    };
+
+    inline void writeCacheStats(std::ostream& out, const char* cache, const CacheStats& stats) {
+        static const char* results[] = { "hit", "miss", "revalidated", "stale", "coalesced" };
+        for (int i = 0; i < CacheResultCount; i++) {
+            out << "weather_cache_requests_total{cache=\"" << cache << "\",result=\"" << results[i] << "\"} "
+                << stats.results[i].load(std::memory_order_relaxed) << "\n";
+        }
+    }
+
+    // Renders everything in the Prometheus text exposition format (0.0.4).
+    inline std::string renderPrometheus() {
+        Registry& r = registry();
+        std::stringstream out;
+
+        out << "# HELP weather_http_request_duration_seconds Time spent handling a request, by route.\n";
+        out << "# TYPE weather_http_request_duration_seconds histogram\n";
+        for (int i = 0; i < RouteCount; i++) {
+            r.routeLatency[i].writePrometheus(out, "weather_http_request_duration_seconds", std::string("route=\"") + routeName((Route)i) + "\"");
+        }
+
+        out << "# HELP weather_http_request_duration_quantile_seconds Request latency quantiles from the HDR buckets.\n";
+        out << "# TYPE weather_http_request_duration_quantile_seconds gauge\n";
+        for (int i = 0; i < RouteCount; i++) {
+            r.routeLatency[i].writeQuantiles(out, "weather_http_request_duration_quantile_seconds", std::string("route=\"") + routeName((Route)i) + "\"");
+        }
+
+        out << "# HELP weather_http_responses_total Responses sent, by route and status class.\n";
+        out << "# TYPE weather_http_responses_total counter\n";
+        for (int i = 0; i < RouteCount; i++) {
+            for (int s = 1; s < 6; s++) {
+                uint64_t n = r.routeStatus[i][s].load(std::memory_order_relaxed);
+                if (n) out << "weather_http_responses_total{route=\"" << routeName((Route)i) << "\",code=\"" << s << "xx\"} " << n << "\n";
+            }
+        }
+
+        out << "# HELP weather_upstream_fetch_duration_seconds Open-Meteo fetch latency.\n";
+        out << "# TYPE weather_upstream_fetch_duration_seconds histogram\n";
+        r.upstreamLatency.writePrometheus(out, "weather_upstream_fetch_duration_seconds", "");
+        out << "# TYPE weather_upstream_fetch_duration_quantile_seconds gauge\n";
+        r.upstreamLatency.writeQuantiles(out, "weather_upstream_fetch_duration_quantile_seconds", "");
+        out << "# TYPE weather_upstream_errors_total counter\n";
+        out << "weather_upstream_errors_total " << r.upstreamErrors.load(std::memory_order_relaxed) << "\n";
+
+        out << "# HELP weather_cache_requests_total Cache lookups by cache and result.\n";
+        out << "# TYPE weather_cache_requests_total counter\n";
+        writeCacheStats(out, "static", r.staticCache);
+        writeCacheStats(out, "city", r.cityCache);
+        writeCacheStats(out, "field", r.fieldCache);
+
+        out << "# TYPE weather_active_connections gauge\n";
+        out << "weather_active_connections " << r.activeConnections.load(std::memory_order_relaxed) << "\n";
+
+        out << "# HELP weather_queue_depth Accepted connections waiting for a worker.\n";
+        out << "# TYPE weather_queue_depth gauge\n";
+        out << "weather_queue_depth " << r.queueDepth.load(std::memory_order_relaxed) << "\n";
+        out << "# HELP weather_shed_total Connections refused with 503 because the queue was full.\n";
+        out << "# TYPE weather_shed_total counter\n";
+        out << "weather_shed_total " << r.shedTotal.load(std::memory_order_relaxed) << "\n";
+        out << "# HELP weather_timeouts_total Requests that ran out of time, by where.\n";
+        out << "# TYPE weather_timeouts_total counter\n";
+        out << "weather_timeouts_total{stage=\"queue\"} " << r.queueExpired.load(std::memory_order_relaxed) << "\n";
+        out << "weather_timeouts_total{stage=\"upstream\"} " << r.deadlineExceeded.load(std::memory_order_relaxed) << "\n";
+        out << "# HELP weather_degraded_total Lookups answered from cache instead of the upstream because of load or budget.\n";
+        out << "# TYPE weather_degraded_total counter\n";
+        out << "weather_degraded_total " << r.degradedServed.load(std::memory_order_relaxed) << "\n";
+
+        out << "# TYPE weather_access_log_records_total counter\n";
+        out << "weather_access_log_records_total{result=\"written\"} " << AccessLog::instance().writtenCount() << "\n";
+        out << "weather_access_log_records_total{result=\"dropped\"} " << AccessLog::instance().droppedCount() << "\n";
+
+        return out.str();
+    }
+}
+
+#endif
@@ -0,0 +1,299 @@
+#ifndef SNAPSHOT_HPP
+#define SNAPSHOT_HPP
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <windows.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <cstring>
+#include <cstdint>
+#include <ctime>
+#include <iostream>
+#include <stdexcept>
+#include "WeatherEngine.hpp"
+
+// Binary checkpoint of every City so a restart can serve last-known weather
+// immediately instead of blocking each first request on Open-Meteo.
+//
+// Layout (little-endian, as written by x86/x64):
+//   header  : "MWBS" | u32 version | u32 cityCount | i64 createdAt | u64 payloadBytes | u64 fnv1a(payload)
+//   payload : cityCount records of
+//             str name | f64 lat | f64 lon | i32 temp, humidity, wind, wind_dir | str condition | i64 lastUpdated
+//             | i32[] hourly | i32[] weekly | i32[] monthly | i32[] yearly
+//             | u32 n, n x (str day | i32 high | i32 low | i32 rain_prob | str condition)
+//             | str[] alerts | str[] news
+//   str = u32 length + bytes, T[] = u32 count + items.
+// Bump kVersion whenever the record layout changes; older files are ignored.
+
+namespace Snapshot {
+
+    static const char kMagic[4] = { 'M', 'W', 'B', 'S' };
+    static const uint32_t kVersion = 1;
+    static const size_t kHeaderSize = 4 + 4 + 4 + 8 + 8 + 8;
+    // Smallest possible record: empty strings and arrays, no forecast days.
+    // The header is not covered by the checksum, so cityCount is checked
+    // against this before anything is allocated for it.
+    static const size_t kMinRecordSize = 4 + 8 + 8 + 4 * 4 + 4 + 8 + 4 * 4 + 4 + 4 + 4;
+
+    inline uint64_t fnv1a(const char* data, size_t size) {
+        uint64_t hash = 14695981039346656037ULL;
+        for (size_t i = 0; i < size; i++) {
+            hash ^= (unsigned char)data[i];
+            hash *= 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    class Writer {
+    public:
+        std::string buffer;
+
+        template <typename T> void put(T value) { buffer.append(reinterpret_cast<const char*>(&value), sizeof(T)); }
+        void putString(const std::string& s) { put<uint32_t>((uint32_t)s.size()); buffer.append(s); }
+        void putInts(const std::vector<int>& v) {
+            put<uint32_t>((uint32_t)v.size());
+            for (int x : v) put<int32_t>(x);
+        }
+        void putStrings(const std::vector<std::string>& v) {
+            put<uint32_t>((uint32_t)v.size());
+            for (const auto& s : v) putString(s);
+        }
+    };
+
+    // Bounds-checked cursor over a mapped file; any overrun flips `ok` and
+    // every later read returns zero values.
+    class Reader {
+    public:
+        Reader(const char* data, size_t size) : cur(data), end(data + size) {}
+        bool ok = true;
+
+        template <typename T> T get() {
+            T value{};
+            if (!ok || (size_t)(end - cur) < sizeof(T)) { ok = false; return value; }
+            memcpy(&value, cur, sizeof(T));
+            cur += sizeof(T);
+            return value;
+        }
+        std::string getString() {
+            uint32_t len = get<uint32_t>();
+            if (!ok || (size_t)(end - cur) < len) { ok = false; return ""; }
+            std::string s(cur, len);
+            cur += len;
+            return s;
+        }
+        std::vector<int> getInts() {
+            uint32_t n = get<uint32_t>();
+            std::vector<int> v;
+            if (!ok || (size_t)(end - cur) / sizeof(int32_t) < n) { ok = false; return v; }
+            v.reserve(n);
+            for (uint32_t i = 0; i < n; i++) v.push_back(get<int32_t>());
+            return v;
+        }
+        std::vector<std::string> getStrings() {
+            uint32_t n = get<uint32_t>();
+            std::vector<std::string> v;
+            if (!ok || (size_t)(end - cur) / sizeof(uint32_t) < n) { ok = false; return v; }
+            for (uint32_t i = 0; i < n && ok; i++) v.push_back(getString());
+            return v;
+        }
+        size_t remaining() const { return (size_t)(end - cur); }
+
+    private:
+        const char* cur;
+        const char* end;
+    };
+
+    inline std::string encode(const std::vector<City>& cities, int64_t createdAt) {
+        Writer payload;
+        for (const City& c : cities) {
+            payload.putString(c.name);
+            payload.put<double>(c.lat);
+            payload.put<double>(c.lon);
+            payload.put<int32_t>(c.temp);
+            payload.put<int32_t>(c.humidity);
+            payload.put<int32_t>(c.wind);
+            payload.put<int32_t>(c.wind_dir);
+            payload.putString(c.condition);
+            payload.put<int64_t>(c.lastUpdated);
+            payload.putInts(c.hourlyData);
+            payload.putInts(c.weeklyData);
+            payload.putInts(c.monthlyData);
+            payload.putInts(c.yearlyData);
+            payload.put<uint32_t>((uint32_t)c.tenDayForecast.size());
+            for (const DailyForecast& d : c.tenDayForecast) {
+                payload.putString(d.dayName);
+                payload.put<int32_t>(d.high);
+                payload.put<int32_t>(d.low);
+                payload.put<int32_t>(d.rain_prob);
+                payload.putString(d.condition);
+            }
+            payload.putStrings(c.activeAlerts);
+            payload.putStrings(c.weatherNews);
+        }
+
+        Writer file;
+        file.buffer.append(kMagic, sizeof(kMagic));
+        file.put<uint32_t>(kVersion);
+        file.put<uint32_t>((uint32_t)cities.size());
+        file.put<int64_t>(createdAt);
+        file.put<uint64_t>((uint64_t)payload.buffer.size());
+        file.put<uint64_t>(fnv1a(payload.buffer.data(), payload.buffer.size()));
+        file.buffer += payload.buffer;
+        return file.buffer;
+    }
+
+    inline bool decode(const char* data, size_t size, std::vector<City>& out, std::string& error) {
+        if (size < kHeaderSize || memcmp(data, kMagic, sizeof(kMagic)) != 0) { error = "not a snapshot file"; return false; }
+        Reader header(data + sizeof(kMagic), kHeaderSize - sizeof(kMagic));
+        uint32_t version = header.get<uint32_t>();
+        uint32_t count = header.get<uint32_t>();
+        header.get<int64_t>(); // createdAt
+        uint64_t payloadBytes = header.get<uint64_t>();
+        uint64_t checksum = header.get<uint64_t>();
+        if (version != kVersion) { error = "unsupported version " + std::to_string(version); return false; }
+        if (payloadBytes != size - kHeaderSize) { error = "truncated file"; return false; }
+        if (count > payloadBytes / kMinRecordSize) { error = "city count does not fit the payload"; return false; }
+        const char* payload = data + kHeaderSize;
+        if (fnv1a(payload, (size_t)payloadBytes) != checksum) { error = "checksum mismatch"; return false; }
+
+        Reader in(payload, (size_t)payloadBytes);
+        out.clear();
+        out.reserve(count);
+        for (uint32_t i = 0; i < count && in.ok; i++) {
+            City c;
+            c.name = in.getString();
+            c.lat = in.get<double>();
+            c.lon = in.get<double>();
+            c.temp = in.get<int32_t>();
+            c.humidity = in.get<int32_t>();
+            c.wind = in.get<int32_t>();
+            c.wind_dir = in.get<int32_t>();
+            c.condition = in.getString();
+            c.lastUpdated = in.get<int64_t>();
+            c.hourlyData = in.getInts();
+            c.weeklyData = in.getInts();
+            c.monthlyData = in.getInts();
+            c.yearlyData = in.getInts();
+            uint32_t days = in.get<uint32_t>();
+            for (uint32_t d = 0; d < days && in.ok; d++) {
+                DailyForecast f;
+                f.dayName = in.getString();
+                f.high = in.get<int32_t>();
+                f.low = in.get<int32_t>();
+                f.rain_prob = in.get<int32_t>();
+                f.condition = in.getString();
+                c.tenDayForecast.push_back(f);
+            }
+            c.activeAlerts = in.getStrings();
+            c.weatherNews = in.getStrings();
+            out.push_back(c);
+        }
+        if (!in.ok || in.remaining() != 0) { error = "corrupt record data"; return false; }
+        return true;
+    }
+
+    // Writes to `path.tmp`, flushes it to disk, then renames over `path`, so a
+    // crash mid-write never leaves a half-written snapshot behind.
+    inline bool writeFileAtomic(const std::string& path, const std::string& bytes) {
+        std::string tmp = path + ".tmp";
+        HANDLE file = CreateFileA(tmp.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE) return false;
+
+        size_t offset = 0;
+        bool ok = true;
+        while (ok && offset < bytes.size()) {
+            DWORD chunk = (DWORD)std::min<size_t>(bytes.size() - offset, 1 << 20);
+            DWORD written = 0;
+            ok = WriteFile(file, bytes.data() + offset, chunk, &written, NULL) && written == chunk;
+            offset += written;
+        }
+        ok = ok && FlushFileBuffers(file);
+        CloseHandle(file);
+
+        if (!ok || !MoveFileExA(tmp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+            DeleteFileA(tmp.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    // Maps the snapshot read-only and decodes it in place.
+    inline bool loadMapped(const std::string& path, std::vector<City>& out, std::string& error) {
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE) { error = "no snapshot"; return false; }
+
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+            CloseHandle(file);
+            error = "empty file";
+            return false;
+        }
+
+        HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (!mapping) {
+            CloseHandle(file);
+            error = "cannot map file";
+            return false;
+        }
+        const char* view = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        bool ok = false;
+        if (view) {
+            try {
+                ok = decode(view, (size_t)size.QuadPart, out, error);
+            }
+            catch (const std::exception& e) {
+                error = std::string("decode failed: ") + e.what();
+            }
+            UnmapViewOfFile(view);
+        }
+        else {
+            error = "cannot map view";
+        }
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return ok;
+    }
+
+    // Restores the engine from `path`, if a usable snapshot is there. Any
+    // failure, including an exception while restoring, means a cold start.
+    inline size_t loadInto(WeatherEngine& engine, const std::string& path) {
+        auto started = std::chrono::steady_clock::now();
+        std::vector<City> cities;
+        std::string error;
+        size_t restored = 0;
+        try {
+            if (loadMapped(path, cities, error)) restored = engine.restoreCities(cities);
+        }
+        catch (const std::exception& e) {
+            error = e.what();
+        }
+        if (!error.empty()) {
+            std::cout << "Snapshot: starting cold (" << error << ")" << std::endl;
+            return 0;
+        }
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started).count();
+        std::cout << "Snapshot: restored " << restored << " cities from " << path << " in " << ms << " ms" << std::endl;
+        return restored;
+    }
+
+    // Background checkpointer: every `interval`, writes a new snapshot if any
+    // city has changed since the last one.
+    inline void startCheckpointer(WeatherEngine& engine, const std::string& path, std::chrono::seconds interval) {
+        std::thread([&engine, path, interval]() {
+            uint64_t lastWritten = engine.getDataVersion();
+            while (true) {
+                std::this_thread::sleep_for(interval);
+                uint64_t version = engine.getDataVersion();
+                if (version == lastWritten) continue;
+                std::string bytes = encode(engine.exportCities(), (int64_t)std::time(nullptr));
+                if (writeFileAtomic(path, bytes)) lastWritten = version;
+                else std::cerr << "Snapshot: failed to write " << path << std::endl;
+            }
+        }).detach();
+    }
+}
+
+#endif
@@ -0,0 +1,268 @@
+#ifndef STATIC_ASSETS_HPP
+#define STATIC_ASSETS_HPP
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <winsock2.h>
+#include <windows.h>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <algorithm>
+#include <unordered_map>
+#include "NetworkUtils.hpp"
+#include "Metrics.hpp"
+
+namespace SimpleServer {
+
+    // One file held in memory, together with any precompressed siblings
+    // (index.html.gz / index.html.br) found next to it on disk.
+    // Instances are immutable once published, so a response can keep
+    // sending from the buffer while a newer version is being loaded.
+    struct StaticAsset {
+        std::string path;
+        std::string contentType;
+        std::string identity;
+        std::string gzip;
+        std::string brotli;
+        std::string etag;          // quoted, ready for the header; identity body
+        std::string etagGzip;      // each content coding is its own representation,
+        std::string etagBrotli;    // so it gets its own strong validator
+        std::string lastModified;  // RFC 1123 date
+        FILETIME writeTime = { 0, 0 };
+    };
+
+    inline bool getFileWriteTime(const std::string& path, FILETIME& out) {
+        WIN32_FILE_ATTRIBUTE_DATA info;
+        if (!GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &info)) return false;
+        out = info.ftLastWriteTime;
+        return true;
+    }
+
+    inline bool sameFileTime(const FILETIME& a, const FILETIME& b) {
+        return a.dwLowDateTime == b.dwLowDateTime && a.dwHighDateTime == b.dwHighDateTime;
+    }
+
+    inline bool notOlderThan(const FILETIME& a, const FILETIME& b) {
+        ULONGLONG ua = ((ULONGLONG)a.dwHighDateTime << 32) | a.dwLowDateTime;
+        ULONGLONG ub = ((ULONGLONG)b.dwHighDateTime << 32) | b.dwLowDateTime;
+        return ua >= ub;
+    }
+
+    inline bool readBinaryFile(const std::string& path, std::string& out) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open()) return false;
+        std::stringstream buffer;
+        buffer << file.rdbuf();
+        out = buffer.str();
+        return true;
+    }
+
+    inline std::string formatHttpDate(const FILETIME& ft) {
+        SYSTEMTIME st;
+        if (!FileTimeToSystemTime(&ft, &st)) return "";
+        const char* days[] = { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat" };
+        const char* months[] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+        char buf[64];
+        snprintf(buf, sizeof(buf), "%s, %02d %s %04d %02d:%02d:%02d GMT",
+            days[st.wDayOfWeek % 7], st.wDay, months[(st.wMonth + 11) % 12], st.wYear, st.wHour, st.wMinute, st.wSecond);
+        return buf;
+    }
+
+    // FNV-1a over the identity bytes; cheap and stable across restarts.
+    // Encoded variants append a suffix ("-gz", "-br") to the same tag.
+    inline std::string makeEtag(const std::string& body, const char* suffix = "") {
+        uint64_t hash = 14695981039346656037ULL;
+        for (unsigned char ch : body) {
+            hash ^= ch;
+            hash *= 1099511628211ULL;
+        }
+        char buf[64];
+        snprintf(buf, sizeof(buf), "\"%llx-%zx%s\"", (unsigned long long)hash, body.size(), suffix);
+        return buf;
+    }
+
+    class StaticAssetCache {
+    private:
+        struct Entry {
+            std::shared_ptr<const StaticAsset> asset;
+            std::chrono::steady_clock::time_point lastCheck;
+        };
+
+        std::unordered_map<std::string, Entry> entries;
+        std::mutex cacheMutex;
+        std::chrono::milliseconds recheckInterval;
+        std::string cacheControl;
+
+        std::shared_ptr<const StaticAsset> load(const std::string& path, const std::string& contentType, const FILETIME& writeTime) {
+            auto asset = std::make_shared<StaticAsset>();
+            if (!readBinaryFile(path, asset->identity)) return nullptr;
+            asset->path = path;
+            asset->contentType = contentType;
+            asset->writeTime = writeTime;
+            asset->etag = makeEtag(asset->identity);
+            asset->etagGzip = makeEtag(asset->identity, "-gz");
+            asset->etagBrotli = makeEtag(asset->identity, "-br");
+            asset->lastModified = formatHttpDate(writeTime);
+
+            // Precompressed variants are produced offline (gzip -k -9, brotli -k).
+            // Ignore them when they are older than the source file.
+            FILETIME variantTime;
+            if (getFileWriteTime(path + ".gz", variantTime) && notOlderThan(variantTime, writeTime))
+                readBinaryFile(path + ".gz", asset->gzip);
+            if (getFileWriteTime(path + ".br", variantTime) && notOlderThan(variantTime, writeTime))
+                readBinaryFile(path + ".br", asset->brotli);
+            return asset;
+        }
+
+    public:
+        explicit StaticAssetCache(std::chrono::milliseconds recheck = std::chrono::milliseconds(1000),
+            const std::string& cacheControlValue = "public, max-age=60, must-revalidate")
+            : recheckInterval(recheck), cacheControl(cacheControlValue) {}
+
+        const std::string& getCacheControl() const { return cacheControl; }
+
+        // Returns the in-memory copy, reloading it when the file on disk has
+        // changed. The disk is consulted at most once per recheck interval.
+        std::shared_ptr<const StaticAsset> get(const std::string& path, const std::string& contentType) {
+            auto now = std::chrono::steady_clock::now();
+            {
+                std::lock_guard<std::mutex> lock(cacheMutex);
+                auto it = entries.find(path);
+                if (it != entries.end() && now - it->second.lastCheck < recheckInterval) {
+                    Metrics::registry().staticCache.record(Metrics::CacheHit);
+                    return it->second.asset;
+                }
+            }
+
+            FILETIME writeTime;
+            if (!getFileWriteTime(path, writeTime)) return nullptr;
+
+            {
+                std::lock_guard<std::mutex> lock(cacheMutex);
+                auto it = entries.find(path);
+                if (it != entries.end() && it->second.asset && sameFileTime(it->second.asset->writeTime, writeTime)) {
+                    it->second.lastCheck = now;
+                    Metrics::registry().staticCache.record(Metrics::CacheHit);
+                    return it->second.asset;
+                }
+            }
+
+            std::shared_ptr<const StaticAsset> fresh = load(path, contentType, writeTime);
+            if (!fresh) return nullptr;
+            Metrics::registry().staticCache.record(Metrics::CacheMiss);
+
+            std::lock_guard<std::mutex> lock(cacheMutex);
+            entries[path] = { fresh, now };
+            return fresh;
+        }
+    };
+
+    inline std::string trimmed(const std::string& s, size_t begin, size_t end) {
+        while (begin < end && (s[begin] == ' ' || s[begin] == '\t')) begin++;
+        while (end > begin && (s[end - 1] == ' ' || s[end - 1] == '\t')) end--;
+        return s.substr(begin, end - begin);
+    }
+
+    inline bool equalsIgnoreCase(const std::string& a, const std::string& b) {
+        if (a.size() != b.size()) return false;
+        for (size_t i = 0; i < a.size(); i++) {
+            if (tolower((unsigned char)a[i]) != tolower((unsigned char)b[i])) return false;
+        }
+        return true;
+    }
+
+    // True if Accept-Encoding lists the coding with a non-zero weight, e.g.
+    // "gzip", "gzip;q=0.5". Any spelling of zero ("q=0", "q = 0.000") refuses.
+    inline bool acceptsEncoding(const std::string& request, const std::string& coding) {
+        std::string accepted = getHeader(request, "Accept-Encoding");
+        size_t itemStart = 0;
+        while (itemStart <= accepted.size()) {
+            size_t itemEnd = accepted.find(',', itemStart);
+            if (itemEnd == std::string::npos) itemEnd = accepted.size();
+
+            size_t nameEnd = std::min(accepted.find(';', itemStart), itemEnd);
+            if (equalsIgnoreCase(trimmed(accepted, itemStart, nameEnd), coding)) {
+                double q = 1.0;
+                size_t paramStart = nameEnd;
+                while (paramStart < itemEnd) {
+                    size_t paramEnd = std::min(accepted.find(';', paramStart + 1), itemEnd);
+                    std::string param = trimmed(accepted, paramStart + 1, paramEnd);
+                    size_t eq = param.find('=');
+                    if (eq != std::string::npos && equalsIgnoreCase(trimmed(param, 0, eq), "q")) {
+                        q = atof(trimmed(param, eq + 1, param.size()).c_str());
+                    }
+                    paramStart = paramEnd;
+                }
+                return q > 0.0;
+            }
+            itemStart = itemEnd + 1;
+        }
+        return false;
+    }
+
+    // If-None-Match may list several tags, weak (W/) or strong; the weak
+    // comparison of RFC 9110 applies, so W/"x" matches "x".
+    inline bool matchesEtag(const std::string& ifNoneMatch, const std::string& etag) {
+        if (trimmed(ifNoneMatch, 0, ifNoneMatch.size()) == "*") return true;
+        size_t itemStart = 0;
+        while (itemStart < ifNoneMatch.size()) {
+            size_t itemEnd = ifNoneMatch.find(',', itemStart);
+            if (itemEnd == std::string::npos) itemEnd = ifNoneMatch.size();
+            std::string tag = trimmed(ifNoneMatch, itemStart, itemEnd);
+            if (tag.compare(0, 2, "W/") == 0) tag.erase(0, 2);
+            if (tag == etag) return true;
+            itemStart = itemEnd + 1;
+        }
+        return false;
+    }
+
+    // Sends the asset honouring conditional and content-negotiation headers.
+    // Header and body go out in a single gather write straight from the
+    // cached buffer, so the body is never copied into a response string.
+    inline ResponseInfo sendAsset(SOCKET clientSock, const std::shared_ptr<const StaticAsset>& asset, const std::string& request, const std::string& cacheControl) {
+        const std::string* body = &asset->identity;
+        const std::string* etag = &asset->etag;
+        const char* encoding = nullptr;
+        if (!asset->brotli.empty() && acceptsEncoding(request, "br")) { body = &asset->brotli; etag = &asset->etagBrotli; encoding = "br"; }
+        else if (!asset->gzip.empty() && acceptsEncoding(request, "gzip")) { body = &asset->gzip; etag = &asset->etagGzip; encoding = "gzip"; }
+
+        // Validators are compared against the representation being selected,
+        // so a 304 never relabels a cached body of another coding.
+        std::string ifNoneMatch = getHeader(request, "If-None-Match");
+        std::string ifModifiedSince = getHeader(request, "If-Modified-Since");
+        bool notModified = !ifNoneMatch.empty()
+            ? matchesEtag(ifNoneMatch, *etag)
+            : (!ifModifiedSince.empty() && ifModifiedSince == asset->lastModified);
+
+        std::string header = notModified ? "HTTP/1.1 304 Not Modified\r\n" : "HTTP/1.1 200 OK\r\n";
+        header += "ETag: " + *etag + "\r\n";
+        if (!asset->lastModified.empty()) header += "Last-Modified: " + asset->lastModified + "\r\n";
+        header += "Cache-Control: " + cacheControl + "\r\n";
+        header += "Vary: Accept-Encoding\r\n";
+        if (!notModified) {
+            header += "Content-Type: " + asset->contentType + "\r\n";
+            if (encoding) header += std::string("Content-Encoding: ") + encoding + "\r\n";
+            header += "Content-Length: " + std::to_string(body->size()) + "\r\n";
+        }
+        header += "Connection: close\r\n\r\n";
+
+        WSABUF buffers[2];
+        buffers[0].buf = const_cast<char*>(header.data());
+        buffers[0].len = (unsigned long)header.size();
+        buffers[1].buf = const_cast<char*>(body->data());
+        buffers[1].len = (unsigned long)body->size();
+        DWORD sent = 0;
+        WSASend(clientSock, buffers, notModified ? 1 : 2, &sent, 0, NULL, NULL);
+        if (notModified) Metrics::registry().staticCache.record(Metrics::CacheRevalidated);
+        return { notModified ? 304 : 200, (size_t)sent };
+    }
+}
+
+#endif
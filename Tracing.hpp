@@ -0,0 +1,271 @@
+#ifndef TRACING_HPP
+#define TRACING_HPP
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <windows.h>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <cstdint>
+#include "Metrics.hpp"
+
+// Scoped spans and lock profiling. Spans are gated on one relaxed atomic
+// load, so with tracing off a span costs a branch. Profiled locks always
+// keep their per-site counters (two clock reads and a few relaxed atomic
+// adds per acquisition) and only emit trace events during a session.
+// Define WEATHER_NO_TRACING to compile spans out.
+
+namespace Tracing {
+
+    inline std::atomic<bool>& enabledFlag() {
+        static std::atomic<bool> flag{ false };
+        return flag;
+    }
+
+    inline bool enabled() { return enabledFlag().load(std::memory_order_relaxed); }
+
+    struct Event {
+        const char* name;
+        const char* category;
+        uint64_t startMicros;
+        uint64_t durationMicros;
+        std::string detail;
+    };
+
+    // Each thread appends to its own buffer; the per-buffer mutex is only
+    // ever contended while an export is copying it out.
+    struct ThreadBuffer {
+        static const size_t kMaxEvents = 8192;
+        DWORD threadId = 0;
+        std::mutex bufferMutex;
+        std::vector<Event> events;
+    };
+
+    class Collector {
+    public:
+        static const size_t kMaxBuffers = 4096;
+
+        static Collector& instance() {
+            static Collector collector;
+            return collector;
+        }
+
+        void start() {
+            std::lock_guard<std::mutex> lock(registryMutex);
+            buffers.clear();
+            generation.fetch_add(1, std::memory_order_relaxed);
+            enabledFlag().store(true, std::memory_order_relaxed);
+        }
+
+        void stop() { enabledFlag().store(false, std::memory_order_relaxed); }
+
+        void emit(const char* name, const char* category, uint64_t start, uint64_t duration, std::string detail = "") {
+            ThreadBuffer* buffer = localBuffer();
+            if (!buffer) return;
+            std::lock_guard<std::mutex> lock(buffer->bufferMutex);
+            if (buffer->events.size() >= ThreadBuffer::kMaxEvents) {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            buffer->events.push_back({ name, category, start, duration, std::move(detail) });
+        }
+
+        // Chrome / Perfetto "Trace Event Format" (complete events, ph = X).
+        std::string exportChromeJson() {
+            std::vector<std::shared_ptr<ThreadBuffer>> snapshot;
+            {
+                std::lock_guard<std::mutex> lock(registryMutex);
+                snapshot = buffers;
+            }
+
+            std::stringstream out;
+            out << "{\"displayTimeUnit\":\"ms\",\"otherData\":{\"dropped_events\":" << dropped.load(std::memory_order_relaxed) << "},\"traceEvents\":[";
+            bool first = true;
+            for (auto& buffer : snapshot) {
+                std::lock_guard<std::mutex> lock(buffer->bufferMutex);
+                for (const Event& e : buffer->events) {
+                    out << (first ? "" : ",") << "{\"name\":\"" << escape(e.name) << "\",\"cat\":\"" << e.category
+                        << "\",\"ph\":\"X\",\"ts\":" << e.startMicros << ",\"dur\":" << e.durationMicros
+                        << ",\"pid\":1,\"tid\":" << buffer->threadId;
+                    if (!e.detail.empty()) out << ",\"args\":{\"detail\":\"" << escape(e.detail) << "\"}";
+                    out << "}";
+                    first = false;
+                }
+            }
+            out << "]}";
+            return out.str();
+        }
+
+    private:
+        std::mutex registryMutex;
+        std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+        std::atomic<uint64_t> generation{ 0 };
+        std::atomic<uint64_t> dropped{ 0 };
+
+        // Buffers are created lazily, only by threads that record while tracing
+        // is on, and are forgotten when the next session starts.
+        ThreadBuffer* localBuffer() {
+            static thread_local std::shared_ptr<ThreadBuffer> local;
+            static thread_local uint64_t localGeneration = 0;
+            uint64_t current = generation.load(std::memory_order_relaxed);
+            if (local && localGeneration == current) return local.get();
+
+            std::lock_guard<std::mutex> lock(registryMutex);
+            if (buffers.size() >= kMaxBuffers) {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return nullptr;
+            }
+            local = std::make_shared<ThreadBuffer>();
+            local->threadId = GetCurrentThreadId();
+            localGeneration = current;
+            buffers.push_back(local);
+            return local.get();
+        }
+
+        static std::string escape(const std::string& s) {
+            std::string out;
+            for (char ch : s) {
+                if (ch == '"' || ch == '\\') { out += '\\'; out += ch; }
+                else if ((unsigned char)ch < 0x20) out += ' ';
+                else out += ch;
+            }
+            return out;
+        }
+    };
+
+    // Detail built from two parts, joined only if the span is recorded, so
+    // call sites can label spans without allocating when tracing is off.
+    struct JoinedDetail {
+        const std::string& left;
+        const char* separator;
+        const std::string& right;
+    };
+
+    class Span {
+    public:
+        explicit Span(const char* spanName, const char* spanCategory = "app")
+            : name(spanName), category(spanCategory), active(enabled()) {
+            if (active) startMicros = Metrics::nowMicros();
+        }
+        Span(const char* spanName, const std::string& spanDetail, const char* spanCategory = "app")
+            : name(spanName), category(spanCategory), active(enabled()) {
+            if (active) { detail = spanDetail; startMicros = Metrics::nowMicros(); }
+        }
+        Span(const char* spanName, const JoinedDetail& parts, const char* spanCategory = "app")
+            : name(spanName), category(spanCategory), active(enabled()) {
+            if (active) { detail = parts.left + parts.separator + parts.right; startMicros = Metrics::nowMicros(); }
+        }
+        ~Span() {
+            if (active) Collector::instance().emit(name, category, startMicros, Metrics::nowMicros() - startMicros, std::move(detail));
+        }
+        Span(const Span&) = delete;
+        Span& operator=(const Span&) = delete;
+
+    private:
+        const char* name;
+        const char* category;
+        bool active;
+        uint64_t startMicros = 0;
+        std::string detail;
+    };
+
+    // --- LOCK PROFILING ---
+
+    // One per textual lock acquisition (see PROFILED_LOCK). Sites register
+    // themselves on first use and live for the whole process.
+    struct LockSite {
+        const char* function;
+        int line;
+        std::atomic<uint64_t> acquisitions{ 0 };
+        std::atomic<uint64_t> contended{ 0 };
+        std::atomic<uint64_t> waitMicros{ 0 };
+        std::atomic<uint64_t> holdMicros{ 0 };
+        std::atomic<uint64_t> maxWaitMicros{ 0 };
+
+        LockSite(const char* fn, int ln) : function(fn), line(ln) {
+            std::lock_guard<std::mutex> lock(sitesMutex());
+            sites().push_back(this);
+        }
+
+        std::string label() const { return std::string(function) + ":" + std::to_string(line); }
+
+        static std::mutex& sitesMutex() { static std::mutex m; return m; }
+        static std::vector<LockSite*>& sites() { static std::vector<LockSite*> s; return s; }
+    };
+
+    // RAII guard that times how long it waited for, and then held, the mutex.
+    // Counters are always kept; contended acquisitions also show up as
+    // "lock" spans while a trace session is running.
+    template <typename Mutex>
+    class ProfiledLock {
+    public:
+        ProfiledLock(Mutex& m, LockSite& s) : mutex(m), site(s) {
+            uint64_t requested = Metrics::nowMicros();
+            bool waited = !mutex.try_lock();
+            if (waited) mutex.lock();
+            acquiredAt = waited ? Metrics::nowMicros() : requested;
+
+            site.acquisitions.fetch_add(1, std::memory_order_relaxed);
+            if (waited) {
+                uint64_t wait = acquiredAt - requested;
+                site.contended.fetch_add(1, std::memory_order_relaxed);
+                site.waitMicros.fetch_add(wait, std::memory_order_relaxed);
+                uint64_t prevMax = site.maxWaitMicros.load(std::memory_order_relaxed);
+                while (wait > prevMax && !site.maxWaitMicros.compare_exchange_weak(prevMax, wait, std::memory_order_relaxed)) {}
+                if (enabled()) Collector::instance().emit("lock wait", "lock", requested, wait, site.label());
+            }
+        }
+        ~ProfiledLock() {
+            site.holdMicros.fetch_add(Metrics::nowMicros() - acquiredAt, std::memory_order_relaxed);
+            mutex.unlock();
+        }
+        ProfiledLock(const ProfiledLock&) = delete;
+        ProfiledLock& operator=(const ProfiledLock&) = delete;
+
+    private:
+        Mutex& mutex;
+        LockSite& site;
+        uint64_t acquiredAt = 0;
+    };
+
+    inline void writeLockStats(std::ostream& out) {
+        std::lock_guard<std::mutex> lock(LockSite::sitesMutex());
+        out << "# HELP weather_lock_acquisitions_total Profiled lock acquisitions, by call site.\n";
+        out << "# TYPE weather_lock_acquisitions_total counter\n";
+        for (LockSite* s : LockSite::sites())
+            out << "weather_lock_acquisitions_total{site=\"" << s->label() << "\"} " << s->acquisitions.load(std::memory_order_relaxed) << "\n";
+        out << "# TYPE weather_lock_contended_total counter\n";
+        for (LockSite* s : LockSite::sites())
+            out << "weather_lock_contended_total{site=\"" << s->label() << "\"} " << s->contended.load(std::memory_order_relaxed) << "\n";
+        out << "# TYPE weather_lock_wait_seconds_total counter\n";
+        for (LockSite* s : LockSite::sites())
+            out << "weather_lock_wait_seconds_total{site=\"" << s->label() << "\"} " << s->waitMicros.load(std::memory_order_relaxed) / 1e6 << "\n";
+        out << "# TYPE weather_lock_hold_seconds_total counter\n";
+        for (LockSite* s : LockSite::sites())
+            out << "weather_lock_hold_seconds_total{site=\"" << s->label() << "\"} " << s->holdMicros.load(std::memory_order_relaxed) / 1e6 << "\n";
+        out << "# TYPE weather_lock_max_wait_seconds gauge\n";
+        for (LockSite* s : LockSite::sites())
+            out << "weather_lock_max_wait_seconds{site=\"" << s->label() << "\"} " << s->maxWaitMicros.load(std::memory_order_relaxed) / 1e6 << "\n";
+    }
+}
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+#ifdef WEATHER_NO_TRACING
+#define TRACE_SCOPE(...) ((void)0)
+#else
+#define TRACE_SCOPE(...) Tracing::Span TRACE_CONCAT(traceSpan_, __LINE__)(__VA_ARGS__)
+#endif
+
+// Declares `guard` as a profiled lock on the std::mutex `lockable`,
+// attributed to this call site.
+#define PROFILED_LOCK(guard, lockable) \
+    static Tracing::LockSite TRACE_CONCAT(guard, Site_)(__FUNCTION__, __LINE__); \
+    Tracing::ProfiledLock<std::mutex> guard(lockable, TRACE_CONCAT(guard, Site_))
+
+#endif
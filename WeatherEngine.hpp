@@ -9,13 +9,17 @@
 #include <unordered_map>
 #include <queue>
 #include <algorithm>
-#include <stack>
 #include <mutex>
 #include <cmath>
 #include <sstream> 
 #include <ctime> 
 #include <cstdio>
+#include <atomic>
+#include <thread>
+#include <unordered_set>
 #include "NetworkUtils.hpp"
+#include "Metrics.hpp"
+#include "Tracing.hpp"
 
 // --- DATA MODELS ---
 
@@ -39,6 +43,8 @@ struct City {
     std::vector<DailyForecast> tenDayForecast;
     std::vector<std::string> activeAlerts;
     std::vector<std::string> weatherNews;
+
+    int64_t lastUpdated = 0; // unix seconds of the last successful fetch, 0 = never
 };
 
 struct Alert {
@@ -66,8 +72,13 @@ private:
     std::unordered_map<std::string, City> cityDatabase;
     std::unordered_map<std::string, std::vector<std::string>> cityGraph;
     std::priority_queue<Alert> alertSystem;
-    std::stack<std::string> requestLogs;
     std::mutex engineMutex;
+    std::unordered_set<std::string> refreshInFlight;
+    std::atomic<uint64_t> dataVersion{ 0 };
+
+    // Readings younger than this are served as-is; older ones are served
+    // while a background refresh runs.
+    static const int64_t kFreshSeconds = 120;
 
     // --- UTILS ---
 
@@ -94,6 +105,7 @@ private:
     }
 
     double extractJsonValue(const std::string& json, const std::string& key, size_t startPos = 0) {
+        TRACE_SCOPE("extractJsonValue", "parse");
         size_t pos = json.find("\"" + key + "\":", startPos);
         if (pos == std::string::npos) return 0.0;
         size_t valueStart = pos + key.length() + 3;
@@ -116,6 +128,7 @@ private:
     }
 
     std::vector<double> parseJsonArray(const std::string& json, const std::string& key, size_t startPos, size_t limit) {
+        TRACE_SCOPE("parseJsonArray", "parse");
         std::vector<double> result;
         size_t keyPos = json.find("\"" + key + "\":", startPos);
         if (keyPos == std::string::npos) return result;
@@ -136,6 +149,7 @@ private:
     }
 
     std::vector<std::string> parseStringArray(const std::string& json, const std::string& key, size_t startPos, size_t limit) {
+        TRACE_SCOPE("parseStringArray", "parse");
         std::vector<std::string> result;
         size_t keyPos = json.find("\"" + key + "\":", startPos);
         if (keyPos == std::string::npos) return result;
@@ -156,12 +170,12 @@ private:
 
 public:
     void addCity(const City& c) {
-        std::lock_guard<std::mutex> lock(engineMutex);
+        PROFILED_LOCK(lock, engineMutex);
         cityDatabase[c.name] = c;
     }
 
     std::vector<std::string> getCityList() {
-        std::lock_guard<std::mutex> lock(engineMutex);
+        PROFILED_LOCK(lock, engineMutex);
         std::vector<std::string> list;
         for (auto const& pair : cityDatabase) {
             list.push_back(pair.first);
@@ -172,118 +186,220 @@ public:
 
     // --- MAIN FETCH LOGIC ---
     void fetchRealTimeData(const std::string& name) {
+        TRACE_SCOPE("fetchRealTimeData", name);
         double currentLat, currentLon;
 
         {
-            std::lock_guard<std::mutex> lock(engineMutex);
+            PROFILED_LOCK(lock, engineMutex);
             if (cityDatabase.find(name) == cityDatabase.end()) return;
             currentLat = cityDatabase[name].lat;
             currentLon = cityDatabase[name].lon;
         }
 
-        std::string url = "https://api.open-meteo.com/v1/forecast?latitude=" + std::to_string(currentLat)
+        std::string url = SimpleServer::upstreamBaseUrl() + "/v1/forecast?latitude=" + std::to_string(currentLat)
             + "&longitude=" + std::to_string(currentLon)
             + "&current=temperature_2m,relative_humidity_2m,wind_speed_10m,wind_direction_10m,weather_code"
             + "&hourly=temperature_2m"
             + "&daily=temperature_2m_max,temperature_2m_min,precipitation_probability_max,weather_code"
             + "&forecast_days=16";
 
+        uint64_t fetchStart = Metrics::nowMicros();
         std::string json = SimpleServer::fetchURL(url);
+        Metrics::registry().upstreamLatency.record(Metrics::nowMicros() - fetchStart);
+        if (json.empty()) Metrics::registry().upstreamErrors.fetch_add(1, std::memory_order_relaxed);
 
-        if (!json.empty()) {
-            std::lock_guard<std::mutex> lock(engineMutex);
+        if (!json.empty()) applyForecastJson(name, json);
+    }
 
-            if (cityDatabase.find(name) == cityDatabase.end()) return;
-            City& c = cityDatabase[name];
-
-            size_t currentBlock = json.find("\"current\":");
-            if (currentBlock != std::string::npos) {
-                c.temp = (int)extractJsonValue(json, "temperature_2m", currentBlock);
-                c.humidity = (int)extractJsonValue(json, "relative_humidity_2m", currentBlock);
-                c.wind = (int)extractJsonValue(json, "wind_speed_10m", currentBlock);
-                c.wind_dir = (int)extractJsonValue(json, "wind_direction_10m", currentBlock);
-                c.condition = decodeWeatherCode((int)extractJsonValue(json, "weather_code", currentBlock));
-            }
+    // Parses an Open-Meteo forecast payload into the named city (current
+    // conditions, hourly and 10-day series, alerts and news).
+    void applyForecastJson(const std::string& name, const std::string& json) {
+        PROFILED_LOCK(lock, engineMutex);
+        TRACE_SCOPE("applyForecast", "parse");
 
-            size_t hourlyBlock = json.find("\"hourly\":");
-            std::vector<double> hourlyRaw = parseJsonArray(json, "temperature_2m", hourlyBlock, 24);
-            c.hourlyData.clear();
-            for (double d : hourlyRaw) c.hourlyData.push_back((int)d);
-
-            c.weeklyData.clear(); c.monthlyData.clear(); c.yearlyData.clear();
-            for (int i = 0; i < 7; i++) c.weeklyData.push_back(c.temp + (i % 3) - 1);
-            for (int i = 0; i < 30; i++) c.monthlyData.push_back(c.temp + (i % 5) - 2);
-            for (int i = 0; i < 12; i++) c.yearlyData.push_back(c.temp + (i % 4) * 2);
-
-            c.tenDayForecast.clear();
-            size_t dailyBlock = json.find("\"daily\":");
-            if (dailyBlock != std::string::npos) {
-                std::vector<std::string> dates = parseStringArray(json, "time", dailyBlock, 10);
-                std::vector<double> maxTemps = parseJsonArray(json, "temperature_2m_max", dailyBlock, 10);
-                std::vector<double> minTemps = parseJsonArray(json, "temperature_2m_min", dailyBlock, 10);
-                std::vector<double> rainProbs = parseJsonArray(json, "precipitation_probability_max", dailyBlock, 10);
-                std::vector<double> weatherCodes = parseJsonArray(json, "weather_code", dailyBlock, 10);
-
-                size_t count = std::min({ dates.size(), maxTemps.size(), minTemps.size() });
-                if (count > 10) count = 10;
-                for (size_t i = 0; i < count; i++) {
-                    DailyForecast df;
-                    df.dayName = getDayName(dates[i]);
-                    df.high = (int)maxTemps[i]; df.low = (int)minTemps[i];
-                    df.rain_prob = (i < rainProbs.size()) ? (int)rainProbs[i] : 0;
-                    if (i < weatherCodes.size()) df.condition = decodeWeatherCode((int)weatherCodes[i]); else df.condition = "Sunny";
-                    c.tenDayForecast.push_back(df);
-                }
+        if (cityDatabase.find(name) == cityDatabase.end()) return;
+
+        // An error body ({"error":true,"reason":...}) has no current block;
+        // keep the previous reading and leave it marked stale.
+        size_t currentBlock = json.find("\"current\":");
+        if (currentBlock == std::string::npos) {
+            Metrics::registry().upstreamErrors.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        City& c = cityDatabase[name];
+        c.temp = (int)extractJsonValue(json, "temperature_2m", currentBlock);
+        c.humidity = (int)extractJsonValue(json, "relative_humidity_2m", currentBlock);
+        c.wind = (int)extractJsonValue(json, "wind_speed_10m", currentBlock);
+        c.wind_dir = (int)extractJsonValue(json, "wind_direction_10m", currentBlock);
+        c.condition = decodeWeatherCode((int)extractJsonValue(json, "weather_code", currentBlock));
+
+        size_t hourlyBlock = json.find("\"hourly\":");
+        std::vector<double> hourlyRaw = parseJsonArray(json, "temperature_2m", hourlyBlock, 24);
+        c.hourlyData.clear();
+        for (double d : hourlyRaw) c.hourlyData.push_back((int)d);
+
+        c.weeklyData.clear(); c.monthlyData.clear(); c.yearlyData.clear();
+        for (int i = 0; i < 7; i++) c.weeklyData.push_back(c.temp + (i % 3) - 1);
+        for (int i = 0; i < 30; i++) c.monthlyData.push_back(c.temp + (i % 5) - 2);
+        for (int i = 0; i < 12; i++) c.yearlyData.push_back(c.temp + (i % 4) * 2);
+
+        c.tenDayForecast.clear();
+        size_t dailyBlock = json.find("\"daily\":");
+        if (dailyBlock != std::string::npos) {
+            std::vector<std::string> dates = parseStringArray(json, "time", dailyBlock, 10);
+            std::vector<double> maxTemps = parseJsonArray(json, "temperature_2m_max", dailyBlock, 10);
+            std::vector<double> minTemps = parseJsonArray(json, "temperature_2m_min", dailyBlock, 10);
+            std::vector<double> rainProbs = parseJsonArray(json, "precipitation_probability_max", dailyBlock, 10);
+            std::vector<double> weatherCodes = parseJsonArray(json, "weather_code", dailyBlock, 10);
+
+            size_t count = std::min({ dates.size(), maxTemps.size(), minTemps.size() });
+            if (count > 10) count = 10;
+            for (size_t i = 0; i < count; i++) {
+                DailyForecast df;
+                df.dayName = getDayName(dates[i]);
+                df.high = (int)maxTemps[i]; df.low = (int)minTemps[i];
+                df.rain_prob = (i < rainProbs.size()) ? (int)rainProbs[i] : 0;
+                if (i < weatherCodes.size()) df.condition = decodeWeatherCode((int)weatherCodes[i]); else df.condition = "Sunny";
+                c.tenDayForecast.push_back(df);
             }
+        }
 
-            // --- ALERTS & NEWS ---
-            c.activeAlerts.clear();
-            c.weatherNews.clear();
+        // --- ALERTS & NEWS ---
+        c.activeAlerts.clear();
+        c.weatherNews.clear();
 
-            if (c.temp > 40) c.activeAlerts.push_back("Extreme Heat Warning: Temperatures exceeding 40C.");
-            if (c.wind > 30) c.activeAlerts.push_back("High Wind Alert: Batten down the hatches.");
-            if (c.condition == "Stormy") c.activeAlerts.push_back("Severe Thunderstorm Warning active.");
-            if (c.condition == "Rainy" && c.humidity > 90) c.activeAlerts.push_back("Flash Flood Watch: Heavy saturation detected.");
-            if (c.temp < 0) c.activeAlerts.push_back("Freeze Warning: Pipe bursting conditions.");
+        if (c.temp > 40) c.activeAlerts.push_back("Extreme Heat Warning: Temperatures exceeding 40C.");
+        if (c.wind > 30) c.activeAlerts.push_back("High Wind Alert: Batten down the hatches.");
+        if (c.condition == "Stormy") c.activeAlerts.push_back("Severe Thunderstorm Warning active.");
+        if (c.condition == "Rainy" && c.humidity > 90) c.activeAlerts.push_back("Flash Flood Watch: Heavy saturation detected.");
+        if (c.temp < 0) c.activeAlerts.push_back("Freeze Warning: Pipe bursting conditions.");
 
-            if (c.condition == "Rainy") {
-                c.weatherNews.push_back("Heavy Rain expected to continue throughout the evening in " + c.name + ".");
-                c.weatherNews.push_back("Urban flooding risk increases as rain intensifies.");
-            }
-            else if (c.condition == "Stormy") {
-                c.weatherNews.push_back("Severe Thunderstorms approaching " + c.name + " region.");
-            }
-            else if (c.condition == "Cloudy") {
-                c.weatherNews.push_back("Overcast skies dominate " + c.name + " skyline today.");
-            }
-            else if (c.condition == "Sunny" || c.condition == "Clear") {
-                c.weatherNews.push_back("Beautiful Clear Sky attracts tourists to " + c.name + " parks.");
-                if (c.temp > 35) c.weatherNews.push_back("Heatwave alert: Sun intensity reaches peak levels.");
-            }
-            else if (c.condition == "Foggy") {
-                c.weatherNews.push_back("Dense Fog lowers visibility on " + c.name + " highways.");
-            }
-            else if (c.condition == "Snow") {
-                c.weatherNews.push_back("Snowfall transforms " + c.name + " into a winter wonderland.");
-            }
+        if (c.condition == "Rainy") {
+            c.weatherNews.push_back("Heavy Rain expected to continue throughout the evening in " + c.name + ".");
+            c.weatherNews.push_back("Urban flooding risk increases as rain intensifies.");
+        }
+        else if (c.condition == "Stormy") {
+            c.weatherNews.push_back("Severe Thunderstorms approaching " + c.name + " region.");
+        }
+        else if (c.condition == "Cloudy") {
+            c.weatherNews.push_back("Overcast skies dominate " + c.name + " skyline today.");
+        }
+        else if (c.condition == "Sunny" || c.condition == "Clear") {
+            c.weatherNews.push_back("Beautiful Clear Sky attracts tourists to " + c.name + " parks.");
+            if (c.temp > 35) c.weatherNews.push_back("Heatwave alert: Sun intensity reaches peak levels.");
+        }
+        else if (c.condition == "Foggy") {
+            c.weatherNews.push_back("Dense Fog lowers visibility on " + c.name + " highways.");
+        }
+        else if (c.condition == "Snow") {
+            c.weatherNews.push_back("Snowfall transforms " + c.name + " into a winter wonderland.");
+        }
 
-            if (c.wind > 20) c.weatherNews.push_back("Strong Winds reported: Trees and power lines at risk.");
+        if (c.wind > 20) c.weatherNews.push_back("Strong Winds reported: Trees and power lines at risk.");
 
-            if (c.weatherNews.empty()) {
-                c.weatherNews.push_back("Stable weather conditions expected for the next 24 hours in " + c.name + ".");
-            }
+        if (c.weatherNews.empty()) {
+            c.weatherNews.push_back("Stable weather conditions expected for the next 24 hours in " + c.name + ".");
         }
+
+        // Stamped last, once the payload has parsed, so only real readings count as fresh.
+        c.lastUpdated = (int64_t)std::time(nullptr);
+        dataVersion.fetch_add(1, std::memory_order_relaxed);
     }
 
-    City* getCity(const std::string& name) {
-        if (cityDatabase.find(name) != cityDatabase.end()) return &cityDatabase[name];
-        return nullptr;
+    // Copies the city out under engineMutex. Request handlers work on the
+    // copy, since a background refresh may rewrite the stored City at any time.
+    bool copyCity(const std::string& name, City& out) {
+        PROFILED_LOCK(lock, engineMutex);
+        auto it = cityDatabase.find(name);
+        if (it == cityDatabase.end()) return false;
+        out = it->second;
+        return true;
+    }
+
+    // Calls visit(const City&) for every city under engineMutex, for callers
+    // that need a few fields of each city without copying whole cities.
+    template <typename Visitor>
+    void forEachCity(Visitor&& visit) {
+        PROFILED_LOCK(lock, engineMutex);
+        for (const auto& pair : cityDatabase) visit(pair.second);
+    }
+    // Makes sure the city has data to serve. Only a city that has never been
+    // fetched blocks on the upstream; stale data is served immediately and
+    // refreshed in the background, at most one refresh per city at a time.
+    // A stale city requested while the server is over budget is served as
+    // cached, without scheduling a refresh.
+    void updateCity(const std::string& name) {
+        int64_t lastUpdated;
+        {
+            PROFILED_LOCK(lock, engineMutex);
+            auto it = cityDatabase.find(name);
+            if (it == cityDatabase.end()) return;
+            lastUpdated = it->second.lastUpdated;
+        }
+
+        if (lastUpdated == 0) {
+            Metrics::registry().cityCache.record(Metrics::CacheMiss);
+            fetchRealTimeData(name);
+            return;
+        }
+        if ((int64_t)std::time(nullptr) - lastUpdated < kFreshSeconds) {
+            Metrics::registry().cityCache.record(Metrics::CacheHit);
+            return;
+        }
+        Metrics::registry().cityCache.record(Metrics::CacheStale);
+        if (SimpleServer::shouldAvoidUpstream()) {
+            // Over budget: answer with what we have and leave the upstream alone.
+            Metrics::registry().degradedServed.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        refreshInBackground(name);
+    }
+
+    void refreshInBackground(const std::string& name) {
+        {
+            PROFILED_LOCK(lock, engineMutex);
+            if (!refreshInFlight.insert(name).second) return;
+        }
+        std::thread([this, name]() {
+            fetchRealTimeData(name);
+            PROFILED_LOCK(lock, engineMutex);
+            refreshInFlight.erase(name);
+        }).detach();
+    }
+
+    // --- SNAPSHOT SUPPORT ---
+
+    // Bumped whenever city readings change; lets the checkpointer skip
+    // writing when nothing is new.
+    uint64_t getDataVersion() const { return dataVersion.load(std::memory_order_relaxed); }
+
+    std::vector<City> exportCities() {
+        PROFILED_LOCK(lock, engineMutex);
+        std::vector<City> all;
+        all.reserve(cityDatabase.size());
+        for (auto& pair : cityDatabase) all.push_back(pair.second);
+        return all;
+    }
+
+    // Restores readings for cities that are already registered, keeping
+    // whichever copy is newer. Returns how many cities were restored.
+    size_t restoreCities(const std::vector<City>& cities) {
+        PROFILED_LOCK(lock, engineMutex);
+        size_t restored = 0;
+        for (const City& saved : cities) {
+            auto it = cityDatabase.find(saved.name);
+            if (it == cityDatabase.end() || it->second.lastUpdated >= saved.lastUpdated) continue;
+            it->second = saved;
+            restored++;
+        }
+        if (restored) dataVersion.fetch_add(1, std::memory_order_relaxed);
+        return restored;
     }
-    void updateCity(const std::string& name) { fetchRealTimeData(name); }
 
     std::vector<NewsItem> getCityNews(const std::string& cityName) {
         std::vector<NewsItem> newsFeed;
-        std::lock_guard<std::mutex> lock(engineMutex);
+        PROFILED_LOCK(lock, engineMutex);
 
         if (cityDatabase.find(cityName) == cityDatabase.end()) return newsFeed;
 
@@ -305,25 +421,20 @@ public:
     }
 
     void addRoute(const std::string& cityA, const std::string& cityB) {
-        std::lock_guard<std::mutex> lock(engineMutex);
+        PROFILED_LOCK(lock, engineMutex);
         cityGraph[cityA].push_back(cityB); cityGraph[cityB].push_back(cityA);
     }
     std::vector<std::string> getNeighbors(const std::string& name) {
         return cityGraph.count(name) ? cityGraph[name] : std::vector<std::string>{};
     }
     std::vector<City> getHottestCities(int k) {
-        std::lock_guard<std::mutex> lock(engineMutex);
+        PROFILED_LOCK(lock, engineMutex);
         std::vector<City> all;
         for (auto& pair : cityDatabase) all.push_back(pair.second);
         if (k > (int)all.size()) k = (int)all.size();
         std::partial_sort(all.begin(), all.begin() + k, all.end(), [](const City& a, const City& b) { return a.temp > b.temp; });
         all.resize(k); return all;
     }
-    void logRequest(std::string req) {
-        std::lock_guard<std::mutex> lock(engineMutex);
-        requestLogs.push(req);
-        if (requestLogs.size() > 50) requestLogs.pop();
-    }
 
     std::unordered_map<std::string, std::string> calculateLifestyleIndices(const City& c) {
         std::unordered_map<std::string, std::string> indices;
@@ -371,8 +482,9 @@ public:
     }
 
     // --- FIX DIJKSTRA LOGIC ---
-    std::vector<std::string> findBestRoute(std::string start, std::string end) {
-        std::lock_guard<std::mutex> lock(engineMutex);
+    std::vector<std::string> findBestRoute(const std::string& start, const std::string& end) {
+        TRACE_SCOPE("findBestRoute", Tracing::JoinedDetail{ start, " -> ", end });
+        PROFILED_LOCK(lock, engineMutex);
 
         if (cityGraph.find(start) == cityGraph.end() || cityGraph.find(end) == cityGraph.end()) {
             return {};
@@ -0,0 +1,125 @@
+#ifndef WORKER_POOL_HPP
+#define WORKER_POOL_HPP
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <winsock2.h>
+#include <windows.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <chrono>
+#include <functional>
+#include <string>
+#include "NetworkUtils.hpp"
+#include "Metrics.hpp"
+
+namespace SimpleServer {
+
+    // Fixed set of worker threads in front of a bounded queue of accepted
+    // sockets. submit() never blocks: when the queue is full the caller sheds
+    // the connection. Every request gets a deadline measured from the moment
+    // it was accepted; it is exported to the handler through currentBudget().
+    class WorkerPool {
+    public:
+        WorkerPool(size_t threadCount, size_t queueLimit, std::chrono::milliseconds requestBudget, std::function<void(SOCKET)> handler)
+            : maxQueue(queueLimit), budget(requestBudget), handleClient(std::move(handler)) {
+            for (size_t i = 0; i < threadCount; i++) {
+                std::thread(&WorkerPool::workerLoop, this).detach();
+            }
+        }
+
+        // Queues the socket for a worker; returns false if the queue is full.
+        bool submit(SOCKET clientSock) {
+            {
+                std::lock_guard<std::mutex> lock(queueMutex);
+                if (pending.size() >= maxQueue) return false;
+                pending.push_back({ clientSock, std::chrono::steady_clock::now() });
+                Metrics::registry().queueDepth.store((int64_t)pending.size(), std::memory_order_relaxed);
+            }
+            queueReady.notify_one();
+            return true;
+        }
+
+        // Fast refusal used when submit() fails; keeps overload from
+        // turning into unbounded memory and threads.
+        static void shed(SOCKET clientSock) {
+            Metrics::registry().shedTotal.fetch_add(1, std::memory_order_relaxed);
+            refuse(clientSock, "Server busy, try again shortly.");
+        }
+
+    private:
+        struct Task {
+            SOCKET sock;
+            std::chrono::steady_clock::time_point accepted;
+        };
+
+        std::mutex queueMutex;
+        std::condition_variable queueReady;
+        std::deque<Task> pending;
+        size_t maxQueue;
+        std::chrono::milliseconds budget;
+        std::function<void(SOCKET)> handleClient;
+
+        // Sends a 503 on a connection whose request was never read. Closing
+        // with unread bytes in the receive buffer makes the stack send RST,
+        // which can destroy the 503 before the client reads it, so the send
+        // side is shut down first and whatever the client has already sent is
+        // discarded. The socket is switched to non-blocking for that drain:
+        // shed() runs on the accept thread, which must never wait on a client.
+        static void refuse(SOCKET clientSock, const std::string& message) {
+            sendResponse(clientSock, message, "text/plain", 503);
+            shutdown(clientSock, SD_SEND);
+
+            u_long nonBlocking = 1;
+            ioctlsocket(clientSock, FIONBIO, &nonBlocking);
+            char buffer[4096];
+            size_t drained = 0;
+            int n;
+            while (drained < 65536 && (n = recv(clientSock, buffer, sizeof(buffer), 0)) > 0) drained += (size_t)n;
+            closesocket(clientSock);
+        }
+
+        void workerLoop() {
+            while (true) {
+                Task task;
+                bool underPressure;
+                {
+                    std::unique_lock<std::mutex> lock(queueMutex);
+                    queueReady.wait(lock, [this]() { return !pending.empty(); });
+                    task = pending.front();
+                    pending.pop_front();
+                    // Past half full, requests prefer cached data over the upstream.
+                    underPressure = pending.size() * 2 >= maxQueue;
+                    Metrics::registry().queueDepth.store((int64_t)pending.size(), std::memory_order_relaxed);
+                }
+
+                auto deadline = task.accepted + budget;
+                auto now = std::chrono::steady_clock::now();
+                if (now >= deadline) {
+                    // Waited in the queue for its whole budget; the client has likely given up.
+                    Metrics::registry().queueExpired.fetch_add(1, std::memory_order_relaxed);
+                    refuse(task.sock, "Request timed out in queue.");
+                    continue;
+                }
+
+                // A slow client cannot hold a worker past the deadline either,
+                // whether it is slow to send the request or to read the response.
+                DWORD socketTimeout = (DWORD)std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count();
+                setsockopt(task.sock, SOL_SOCKET, SO_RCVTIMEO, (const char*)&socketTimeout, sizeof(socketTimeout));
+                setsockopt(task.sock, SOL_SOCKET, SO_SNDTIMEO, (const char*)&socketTimeout, sizeof(socketTimeout));
+
+                RequestBudget& current = currentBudget();
+                current.active = true;
+                current.degraded = underPressure;
+                current.deadline = deadline;
+                handleClient(task.sock);
+                current = RequestBudget();
+            }
+        }
+    };
+}
+
+#endif
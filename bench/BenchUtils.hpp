@@ -0,0 +1,72 @@
+#ifndef BENCH_UTILS_HPP
+#define BENCH_UTILS_HPP
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <cstdint>
+
+namespace Bench {
+
+    // Keeps results observable so the optimizer cannot drop the work.
+    inline void consume(size_t value) {
+        static volatile size_t sink = 0;
+        sink = sink + value;
+    }
+
+    inline std::string readFile(const std::string& path) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open()) {
+            std::cerr << "Cannot open " << path << std::endl;
+            exit(1);
+        }
+        std::stringstream buffer;
+        buffer << file.rdbuf();
+        return buffer.str();
+    }
+
+    // Grows the batch size until one batch takes ~minSeconds/5, then times five
+    // batches and prints the median ns/op. `fn` returns a value fed to consume().
+    template <typename Fn>
+    void run(const std::string& name, Fn fn, double minSeconds = 0.5) {
+        using clock = std::chrono::steady_clock;
+        consume(fn()); // warm-up
+
+        size_t batch = 1;
+        double batchSeconds = 0;
+        while (true) {
+            auto t0 = clock::now();
+            for (size_t i = 0; i < batch; i++) consume(fn());
+            batchSeconds = std::chrono::duration<double>(clock::now() - t0).count();
+            if (batchSeconds >= minSeconds / 5 || batch >= (1u << 30)) break;
+            batch *= (batchSeconds < minSeconds / 50) ? 10 : 2;
+        }
+
+        std::vector<double> samples;
+        samples.push_back(batchSeconds / batch);
+        for (int r = 0; r < 4; r++) {
+            auto t0 = clock::now();
+            for (size_t i = 0; i < batch; i++) consume(fn());
+            samples.push_back(std::chrono::duration<double>(clock::now() - t0).count() / batch);
+        }
+        std::sort(samples.begin(), samples.end());
+
+        std::cout << std::left << std::setw(44) << name << std::right
+            << std::setw(14) << std::fixed << std::setprecision(1) << samples[2] * 1e9 << " ns/op"
+            << std::setw(12) << batch << " iters/batch" << std::endl;
+    }
+
+    // Nearest-rank percentile over a sorted vector.
+    inline uint64_t percentile(const std::vector<uint64_t>& sorted, double p) {
+        if (sorted.empty()) return 0;
+        size_t rank = (size_t)(p * (double)(sorted.size() - 1) + 0.5);
+        return sorted[std::min(rank, sorted.size() - 1)];
+    }
+}
+
+#endif
@@ -0,0 +1,188 @@
+// Closed-loop HTTP load generator. Each connection thread issues one request,
+// waits for the full response, then issues the next, drawing paths from the
+// dashboard's request mix with a fixed seed so runs are repeatable.
+//
+// Build (from the repo root, in a VS Developer Command Prompt):
+//   cl /std:c++17 /O2 /EHsc bench\loadgen.cpp /Fe:loadgen.exe
+// Run against a server whose upstream is the recorded-payload stub:
+//   start stub_upstream.exe --port 9090
+//   set WEATHER_UPSTREAM=http://127.0.0.1:9090
+//   start main.exe
+//   loadgen.exe --connections 16 --duration 10 --mix dashboard
+// Options: --host, --port, --connections, --duration (seconds), --seed,
+//          --mix dashboard|index (index = only "/", for the static path).
+
+#define _CRT_SECURE_NO_WARNINGS
+#define _WINSOCK_DEPRECATED_NO_WARNINGS
+#define NOMINMAX
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windows.h>
+#include <thread>
+#include <atomic>
+#include <random>
+#include <string>
+#include <vector>
+#include <cstring>
+#include "BenchUtils.hpp"
+
+#pragma comment(lib, "ws2_32.lib")
+
+using namespace std;
+
+struct RequestKind {
+    string label;
+    int weight;
+};
+
+struct Sample {
+    int kind;
+    uint64_t micros;
+};
+
+struct WorkerResult {
+    vector<Sample> samples;
+    uint64_t errors = 0;
+    uint64_t non2xx = 0;
+};
+
+static const char* kCities[] = { "Topi", "Islamabad", "Lahore", "Karachi", "Peshawar", "Quetta", "Multan",
+    "Faisalabad", "Rawalpindi", "Hyderabad", "Sialkot", "Abbottabad", "Murree" };
+static const char* kActivities[] = { "drone", "bbq", "running", "cricket", "construction" };
+
+// Mirrors what index.html does: one page load, the city list, then mostly
+// /data and /news as users switch cities, plus planner and activity lookups.
+static vector<RequestKind> dashboardMix() {
+    return { { "/", 5 }, { "/cities", 10 }, { "/data", 45 }, { "/news", 20 }, { "/predict", 10 }, { "/route", 10 } };
+}
+
+static string makePath(const string& kind, mt19937& rng) {
+    const size_t cityCount = sizeof(kCities) / sizeof(kCities[0]);
+    string a = kCities[rng() % cityCount];
+    if (kind == "/data") return "/data?city=" + a;
+    if (kind == "/news") return "/news?city=" + a;
+    if (kind == "/predict") return "/predict?city=" + a + "&activity=" + kActivities[rng() % 5];
+    if (kind == "/route") return "/route?start=" + a + "&end=" + kCities[rng() % cityCount];
+    return kind;
+}
+
+// Returns the HTTP status, or -1 on a transport error.
+static int doRequest(const sockaddr_in& addr, const string& host, const string& path) {
+    SOCKET sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock == INVALID_SOCKET) return -1;
+    if (connect(sock, (const sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR) {
+        closesocket(sock);
+        return -1;
+    }
+
+    string req = "GET " + path + " HTTP/1.1\r\nHost: " + host + "\r\nAccept-Encoding: gzip, br\r\nConnection: close\r\n\r\n";
+    if (send(sock, req.c_str(), (int)req.size(), 0) == SOCKET_ERROR) {
+        closesocket(sock);
+        return -1;
+    }
+
+    char buffer[16384];
+    char statusLine[16] = { 0 };
+    size_t statusLen = 0;
+    int n;
+    while ((n = recv(sock, buffer, sizeof(buffer), 0)) > 0) {
+        if (statusLen < sizeof(statusLine) - 1) {
+            size_t take = min((size_t)n, sizeof(statusLine) - 1 - statusLen);
+            memcpy(statusLine + statusLen, buffer, take);
+            statusLen += take;
+        }
+    }
+    closesocket(sock);
+    if (n < 0 || statusLen < 12) return -1;
+    return atoi(statusLine + 9); // "HTTP/1.1 200"
+}
+
+int main(int argc, char** argv) {
+    string host = "127.0.0.1";
+    int port = 8080, connections = 16, durationSec = 10;
+    unsigned seed = 1;
+    string mixName = "dashboard";
+    for (int i = 1; i + 1 < argc; i += 2) {
+        string opt = argv[i];
+        if (opt == "--host") host = argv[i + 1];
+        else if (opt == "--port") port = atoi(argv[i + 1]);
+        else if (opt == "--connections") connections = atoi(argv[i + 1]);
+        else if (opt == "--duration") durationSec = atoi(argv[i + 1]);
+        else if (opt == "--seed") seed = (unsigned)atoi(argv[i + 1]);
+        else if (opt == "--mix") mixName = argv[i + 1];
+    }
+
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) return 1;
+
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((unsigned short)port);
+    inet_pton(AF_INET, host.c_str(), &addr.sin_addr);
+
+    vector<RequestKind> mix = mixName == "index" ? vector<RequestKind>{ { "/", 1 } } : dashboardMix();
+    vector<int> weights;
+    for (auto& k : mix) weights.push_back(k.weight);
+
+    atomic<bool> stop{ false };
+    vector<WorkerResult> results(connections);
+    vector<thread> workers;
+    auto started = chrono::steady_clock::now();
+
+    for (int w = 0; w < connections; w++) {
+        workers.emplace_back([&, w]() {
+            mt19937 rng(seed * 7919u + (unsigned)w);
+            discrete_distribution<int> pick(weights.begin(), weights.end());
+            WorkerResult& out = results[w];
+            while (!stop.load(memory_order_relaxed)) {
+                int kind = pick(rng);
+                string path = makePath(mix[kind].label, rng);
+                auto t0 = chrono::steady_clock::now();
+                int status = doRequest(addr, host, path);
+                uint64_t micros = (uint64_t)chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - t0).count();
+                if (status < 0) { out.errors++; continue; }
+                if (status < 200 || status >= 400) out.non2xx++;
+                out.samples.push_back({ kind, micros });
+            }
+        });
+    }
+
+    this_thread::sleep_for(chrono::seconds(durationSec));
+    stop = true;
+    for (auto& t : workers) t.join();
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+
+    vector<uint64_t> all;
+    vector<vector<uint64_t>> byKind(mix.size());
+    uint64_t errors = 0, non2xx = 0;
+    for (auto& r : results) {
+        errors += r.errors;
+        non2xx += r.non2xx;
+        for (auto& s : r.samples) { all.push_back(s.micros); byKind[s.kind].push_back(s.micros); }
+    }
+    sort(all.begin(), all.end());
+
+    cout << fixed << setprecision(2);
+    cout << "mix=" << mixName << " connections=" << connections << " duration=" << elapsed << "s" << endl;
+    cout << "requests=" << all.size() << " errors=" << errors << " non_2xx_3xx=" << non2xx
+        << " throughput=" << all.size() / elapsed << " req/s" << endl;
+    cout << "latency ms: p50=" << Bench::percentile(all, 0.50) / 1000.0
+        << " p99=" << Bench::percentile(all, 0.99) / 1000.0
+        << " p999=" << Bench::percentile(all, 0.999) / 1000.0
+        << " max=" << (all.empty() ? 0 : all.back()) / 1000.0 << endl;
+
+    cout << left << setw(12) << "route" << right << setw(10) << "count" << setw(12) << "p50 ms" << setw(12) << "p99 ms" << setw(12) << "p999 ms" << endl;
+    for (size_t k = 0; k < mix.size(); k++) {
+        auto& v = byKind[k];
+        sort(v.begin(), v.end());
+        cout << left << setw(12) << mix[k].label << right << setw(10) << v.size()
+            << setw(12) << Bench::percentile(v, 0.50) / 1000.0
+            << setw(12) << Bench::percentile(v, 0.99) / 1000.0
+            << setw(12) << Bench::percentile(v, 0.999) / 1000.0 << endl;
+    }
+
+    WSACleanup();
+    return 0;
+}
@@ -0,0 +1,80 @@
+// Offline microbenchmarks for the engine hot paths. Nothing here touches the
+// network: the forecast parser runs on a recorded-format payload and the graph
+// benchmarks run on synthetic grids of cities.
+//
+// Build (from the repo root, in a VS Developer Command Prompt):
+//   cl /std:c++17 /O2 /EHsc /I. bench\microbench.cpp /Fe:microbench.exe
+// Run:
+//   microbench.exe [maxCities] [fixture]
+//   (defaults: 1000000, bench\fixtures\forecast.json)
+
+#define _CRT_SECURE_NO_WARNINGS
+#define NOMINMAX
+
+#include <memory>
+#include <cmath>
+#include <cstdlib>
+#include "WeatherEngine.hpp"
+#include "ApiJson.hpp"
+#include "Field.hpp"
+#include "BenchUtils.hpp"
+
+using namespace std;
+
+// Lays n cities out on a square grid over the region and links each one to its
+// right and lower neighbour, so the route benchmark crosses the whole graph.
+unique_ptr<WeatherEngine> buildSyntheticEngine(size_t n) {
+    auto engine = make_unique<WeatherEngine>();
+    size_t side = (size_t)ceil(sqrt((double)n));
+    for (size_t i = 0; i < n; i++) {
+        City c;
+        c.name = "C" + to_string(i);
+        c.lat = 24.0 + 12.0 * (double)(i / side) / (double)side;
+        c.lon = 61.0 + 16.0 * (double)(i % side) / (double)side;
+        c.temp = 5 + (int)((i * 2654435761u) % 41);
+        c.condition = "Sunny";
+        c.lastUpdated = 1;
+        engine->addCity(c);
+    }
+    for (size_t i = 0; i < n; i++) {
+        if ((i % side) + 1 < side && i + 1 < n) engine->addRoute("C" + to_string(i), "C" + to_string(i + 1));
+        if (i + side < n) engine->addRoute("C" + to_string(i), "C" + to_string(i + side));
+    }
+    return engine;
+}
+
+int main(int argc, char** argv) {
+    size_t maxCities = argc > 1 ? (size_t)strtoull(argv[1], nullptr, 10) : 1000000;
+    string fixturePath = argc > 2 ? argv[2] : "bench/fixtures/forecast.json";
+    string fixture = Bench::readFile(fixturePath);
+
+    cout << "--- forecast parsing (" << fixture.size() << " byte payload) ---" << endl;
+    {
+        WeatherEngine engine;
+        engine.addCity({ "Topi", 34.07, 72.63 });
+        Bench::run("applyForecastJson", [&]() {
+            engine.applyForecastJson("Topi", fixture);
+            return engine.getDataVersion();
+        });
+    }
+
+    for (size_t n = 10; n <= maxCities; n *= 10) {
+        cout << "--- " << n << " cities ---" << endl;
+        auto engine = buildSyntheticEngine(n);
+        engine->applyForecastJson("C0", fixture);
+        string last = "C" + to_string(n - 1);
+        City first;
+        engine->copyCity("C0", first);
+
+        Bench::run("findBestRoute (corner to corner)", [&]() { return engine->findBestRoute("C0", last).size(); });
+        Bench::run("getHottestCities(5)", [&]() { return engine->getHottestCities(5).size(); });
+        Bench::run("ApiJson::cityData (/data body)", [&]() { return ApiJson::cityData(*engine, first).size(); });
+
+        Bench::run("Field::collectSamples (under engineMutex)", [&]() { return Field::collectSamples(*engine, "temp").value.size(); });
+        Field::Samples samples = Field::collectSamples(*engine, "temp");
+        Field::Request field;
+        field.resolution = 128;
+        Bench::run("Field::build 128x128 (/field miss)", [&]() { return Field::build(samples, field, 0)->values.size(); });
+    }
+    return 0;
+}
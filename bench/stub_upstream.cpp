@@ -0,0 +1,71 @@
+// Local stand-in for the Open-Meteo API. Answers every request with the same
+// recorded-format forecast payload, optionally after a fixed delay to model
+// upstream latency. Point the server at it with WEATHER_UPSTREAM.
+//
+// Build (from the repo root, in a VS Developer Command Prompt):
+//   cl /std:c++17 /O2 /EHsc bench\stub_upstream.cpp /Fe:stub_upstream.exe
+// Run:
+//   stub_upstream.exe [--port 9090] [--delay-ms 0] [--fixture bench\fixtures\forecast.json]
+
+#define _CRT_SECURE_NO_WARNINGS
+#define _WINSOCK_DEPRECATED_NO_WARNINGS
+#define NOMINMAX
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windows.h>
+#include <thread>
+#include <string>
+#include <cstring>
+#include "BenchUtils.hpp"
+
+#pragma comment(lib, "ws2_32.lib")
+
+using namespace std;
+
+int main(int argc, char** argv) {
+    int port = 9090, delayMs = 0;
+    string fixturePath = "bench/fixtures/forecast.json";
+    for (int i = 1; i + 1 < argc; i += 2) {
+        string opt = argv[i];
+        if (opt == "--port") port = atoi(argv[i + 1]);
+        else if (opt == "--delay-ms") delayMs = atoi(argv[i + 1]);
+        else if (opt == "--fixture") fixturePath = argv[i + 1];
+    }
+
+    const string body = Bench::readFile(fixturePath);
+    const string response = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: "
+        + to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) return 1;
+
+    SOCKET serverSock = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in serverAddr;
+    memset(&serverAddr, 0, sizeof(serverAddr));
+    serverAddr.sin_family = AF_INET;
+    serverAddr.sin_port = htons((unsigned short)port);
+    serverAddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (bind(serverSock, (struct sockaddr*)&serverAddr, sizeof(serverAddr)) == SOCKET_ERROR) {
+        cout << "Bind failed!" << endl;
+        return 1;
+    }
+    listen(serverSock, SOMAXCONN);
+    cout << "Stub upstream serving " << fixturePath << " (" << body.size() << " bytes) on http://127.0.0.1:" << port
+        << " with " << delayMs << " ms delay" << endl;
+
+    while (true) {
+        SOCKET clientSock = accept(serverSock, nullptr, nullptr);
+        if (clientSock == INVALID_SOCKET) continue;
+        thread([clientSock, delayMs, &response]() {
+            char buffer[4096];
+            recv(clientSock, buffer, sizeof(buffer), 0);
+            if (delayMs > 0) this_thread::sleep_for(chrono::milliseconds(delayMs));
+            send(clientSock, response.c_str(), (int)response.size(), 0);
+            shutdown(clientSock, SD_SEND);
+            closesocket(clientSock);
+        }).detach();
+    }
+    return 0;
+}
@@ -17,10 +17,25 @@
 
 #include "WeatherEngine.hpp"
 #include "NetworkUtils.hpp"
+#include "StaticAssets.hpp"
+#include "Metrics.hpp"
+#include "Tracing.hpp"
+#include "ApiJson.hpp"
+#include "Snapshot.hpp"
+#include "WorkerPool.hpp"
+#include "Field.hpp"
 
 using namespace std;
 
 WeatherEngine engine;
+SimpleServer::StaticAssetCache staticAssets;
+Field::TileCache fieldTiles;
+
+// Admission control: workers mostly wait on the upstream, so there are more
+// of them than cores; anything beyond the queue limit is shed with a 503.
+const size_t kWorkerThreads = 32;
+const size_t kMaxQueuedConnections = 256;
+const chrono::milliseconds kRequestBudget(5000);
 
 // Helper to decode URL params manually (simple version)
 string urlDecode(string str) {
@@ -45,6 +60,9 @@ string urlDecode(string str) {
 }
 
 void handleClient(SOCKET clientSock) {
+    Metrics::ConnectionScope connection;
+    uint64_t startMicros = Metrics::nowMicros();
+
     char buffer[4096];
     int bytesReceived = recv(clientSock, buffer, 4096, 0);
 
@@ -58,15 +76,24 @@ void handleClient(SOCKET clientSock) {
     string method, url;
     ss >> method >> url;
 
+    Metrics::Route route = Metrics::RouteOther;
+    string logCity;
+    SimpleServer::ResponseInfo sent;
+    TRACE_SCOPE("handleClient", url, "http");
+
     // --- ROUTING LOGIC ---
     if (url == "/" || url == "/index.html") {
-        string html = SimpleServer::loadHtmlFile("index.html");
-        SimpleServer::sendResponse(clientSock, html, "text/html");
+        route = Metrics::RouteIndex;
+        auto page = staticAssets.get("index.html", "text/html; charset=utf-8");
+        if (page) sent = SimpleServer::sendAsset(clientSock, page, request, staticAssets.getCacheControl());
+        else sent = SimpleServer::sendResponse(clientSock, "<h1>404 - File Not Found</h1>", "text/html", 404);
     }
     else if (url.find("/news") != string::npos) {
+        route = Metrics::RouteNews;
         string city = SimpleServer::getQueryParam(url, "city");
         city = urlDecode(city);
         if (city.empty()) city = "Topi";
+        logCity = city;
 
         vector<NewsItem> news = engine.getCityNews(city);
 
@@ -80,9 +107,10 @@ void handleClient(SOCKET clientSock) {
             json << "}" << (i < news.size() - 1 ? "," : "");
         }
         json << "]";
-        SimpleServer::sendResponse(clientSock, json.str(), "application/json");
+        sent = SimpleServer::sendResponse(clientSock, json.str(), "application/json");
     }
     else if (url == "/cities") {
+        route = Metrics::RouteCities;
         vector<string> cities = engine.getCityList();
         stringstream json;
         json << "[";
@@ -90,34 +118,91 @@ void handleClient(SOCKET clientSock) {
             json << "\"" << cities[i] << "\"" << (i < cities.size() - 1 ? "," : "");
         }
         json << "]";
-        SimpleServer::sendResponse(clientSock, json.str(), "application/json");
+        sent = SimpleServer::sendResponse(clientSock, json.str(), "application/json");
+    }
+    else if (url == "/metrics") {
+        route = Metrics::RouteMetrics;
+        stringstream body;
+        body << Metrics::renderPrometheus();
+        Tracing::writeLockStats(body);
+        sent = SimpleServer::sendResponse(clientSock, body.str(), "text/plain; version=0.0.4");
+    }
+    else if (url.find("/trace") == 0) {
+        // /trace?action=start begins a session, action=stop ends it,
+        // and plain /trace downloads the Chrome/Perfetto JSON.
+        route = Metrics::RouteTrace;
+        string action = SimpleServer::getQueryParam(url, "action");
+        if (action == "start") {
+            Tracing::Collector::instance().start();
+            sent = SimpleServer::sendResponse(clientSock, "{ \"tracing\": true }", "application/json");
+        }
+        else if (action == "stop") {
+            Tracing::Collector::instance().stop();
+            sent = SimpleServer::sendResponse(clientSock, "{ \"tracing\": false }", "application/json");
+        }
+        else {
+            sent = SimpleServer::sendResponse(clientSock, Tracing::Collector::instance().exportChromeJson(), "application/json");
+        }
+    }
+    else if (url.find("/field") == 0) {
+        // /field?metric=temp|humidity|wind&bbox=west,south,east,north&res=64[&format=f32]
+        route = Metrics::RouteField;
+        Field::Request req;
+        string metric = SimpleServer::getQueryParam(url, "metric");
+        string bbox = urlDecode(SimpleServer::getQueryParam(url, "bbox"));
+        string res = SimpleServer::getQueryParam(url, "res");
+        if (!metric.empty()) req.metric = metric;
+        if (!res.empty()) req.resolution = atoi(res.c_str());
+
+        if (!Field::isSupportedMetric(req.metric)) {
+            sent = SimpleServer::sendResponse(clientSock, "{ \"error\": \"metric must be temp, humidity or wind\" }", "application/json", 400);
+        }
+        else if (!bbox.empty() && !Field::parseBbox(bbox, req)) {
+            sent = SimpleServer::sendResponse(clientSock, "{ \"error\": \"bbox must be west,south,east,north\" }", "application/json", 400);
+        }
+        else if (req.resolution < 2 || req.resolution > Field::kMaxResolution) {
+            sent = SimpleServer::sendResponse(clientSock, "{ \"error\": \"res must be between 2 and 512\" }", "application/json", 400);
+        }
+        else {
+            auto grid = fieldTiles.get(engine, req);
+            if (SimpleServer::getQueryParam(url, "format") == "f32") {
+                sent = SimpleServer::sendResponse(clientSock, Field::toFloat32(*grid), "application/octet-stream", 200, Field::float32Headers(*grid));
+            }
+            else {
+                sent = SimpleServer::sendResponse(clientSock, Field::toJson(*grid, req.metric), "application/json");
+            }
+        }
     }
     else if (url.find("/predict") != string::npos) {
+        route = Metrics::RoutePredict;
         string city = SimpleServer::getQueryParam(url, "city");
         string activity = SimpleServer::getQueryParam(url, "activity");
 
         city = urlDecode(city);
         activity = urlDecode(activity);
+        logCity = city;
 
         engine.updateCity(city);
-        City* c = engine.getCity(city);
+        City c;
 
         stringstream json;
-        if (c) {
-            ActivityResult res = engine.predictActivitySuitability(*c, activity);
+        if (engine.copyCity(city, c)) {
+            ActivityResult res = engine.predictActivitySuitability(c, activity);
             json << "{ \"score\": \"" << res.score << "\", \"message\": \"" << res.message << "\", \"color\": \"" << res.color << "\" }";
         }
         else {
             json << "{ \"score\": \"Unknown\", \"message\": \"City not found.\", \"color\": \"#94a3b8\" }";
         }
-        SimpleServer::sendResponse(clientSock, json.str(), "application/json");
+        sent = SimpleServer::sendResponse(clientSock, json.str(), "application/json");
     }
     else if (url.find("/route") != string::npos) {
+        route = Metrics::RouteRoute;
         string start = SimpleServer::getQueryParam(url, "start");
         string end = SimpleServer::getQueryParam(url, "end");
 
         start = urlDecode(start);
         end = urlDecode(end);
+        logCity = start;
 
         engine.updateCity(start);
         engine.updateCity(end);
@@ -130,87 +215,32 @@ void handleClient(SOCKET clientSock) {
             json << "\"" << path[i] << "\"" << (i < path.size() - 1 ? "," : "");
         }
         json << "] }";
-        SimpleServer::sendResponse(clientSock, json.str(), "application/json");
+        sent = SimpleServer::sendResponse(clientSock, json.str(), "application/json");
     }
     else if (url.find("/data") != string::npos) {
+        route = Metrics::RouteData;
         string cityName = SimpleServer::getQueryParam(url, "city");
         cityName = urlDecode(cityName);
         if (cityName.empty()) cityName = "Topi";
+        logCity = cityName;
 
         engine.updateCity(cityName);
-        City* c = engine.getCity(cityName);
-
-        if (c) {
-            stringstream json;
-            json << "{";
-            json << "\"city\": \"" << c->name << "\",";
-            json << "\"lat\": " << c->lat << ",";
-            json << "\"lon\": " << c->lon << ",";
-            json << "\"current\": {";
-            json << "\"temperature_2d\": " << c->temp << ",";
-            json << "\"wind_speed_10m\": " << c->wind << ",";
-            json << "\"relative_humidity_2d\": " << c->humidity << ",";
-            json << "\"rain\": 0,";
-            json << "\"aqi\": 45,";
-            json << "\"wind_dir\": " << c->wind_dir << ",";
-            json << "\"condition\": \"" << c->condition << "\"";
-            json << "},";
-
-            auto lifestyle = engine.calculateLifestyleIndices(*c);
-            json << "\"lifestyle\": {";
-            json << "\"drone\": \"" << lifestyle["Drone"] << "\",";
-            json << "\"running\": \"" << lifestyle["Running"] << "\",";
-            json << "\"bbq\": \"" << lifestyle["BBQ"] << "\"";
-            json << "},";
-
-            json << "\"hourly\": ["; for (size_t i = 0; i < c->hourlyData.size(); i++) json << c->hourlyData[i] << (i < c->hourlyData.size() - 1 ? "," : ""); json << "],";
-            json << "\"weekly\": ["; for (size_t i = 0; i < c->weeklyData.size(); i++) json << c->weeklyData[i] << (i < c->weeklyData.size() - 1 ? "," : ""); json << "],";
-            json << "\"monthly\": ["; for (size_t i = 0; i < c->monthlyData.size(); i++) json << c->monthlyData[i] << (i < c->monthlyData.size() - 1 ? "," : ""); json << "],";
-            json << "\"yearly\": ["; for (size_t i = 0; i < c->yearlyData.size(); i++) json << c->yearlyData[i] << (i < c->yearlyData.size() - 1 ? "," : ""); json << "],";
-
-            json << "\"forecast\": [";
-            for (size_t i = 0; i < c->tenDayForecast.size(); i++) {
-                json << "{ \"day\": \"" << c->tenDayForecast[i].dayName
-                    << "\", \"high\": " << c->tenDayForecast[i].high
-                    << ", \"low\": " << c->tenDayForecast[i].low
-                    << ", \"rain_prob\": " << c->tenDayForecast[i].rain_prob
-                    << ", \"cond\": \"" << c->tenDayForecast[i].condition << "\" }";
-                if (i < c->tenDayForecast.size() - 1) json << ",";
-            }
-            json << "],";
-
-            json << "\"alerts\": [";
-            for (size_t i = 0; i < c->activeAlerts.size(); i++) {
-                json << "\"" << c->activeAlerts[i] << "\"" << (i < c->activeAlerts.size() - 1 ? "," : "");
-            }
-            json << "],";
-
-            vector<string> neighbors = engine.getNeighbors(cityName);
-            json << "\"neighbors\": [";
-            for (size_t i = 0; i < neighbors.size(); i++) {
-                json << "\"" << neighbors[i] << "\"" << (i < neighbors.size() - 1 ? "," : "");
-            }
-            json << "],";
+        City c;
 
-            vector<City> hottest = engine.getHottestCities(5);
-            json << "\"hottest_cities\": [";
-            for (size_t i = 0; i < hottest.size(); i++) {
-                json << "{\"name\": \"" << hottest[i].name << "\", \"temp\": " << hottest[i].temp << "}" << (i < hottest.size() - 1 ? "," : "");
-            }
-            json << "]";
-
-            json << "}";
-            SimpleServer::sendResponse(clientSock, json.str(), "application/json");
+        if (engine.copyCity(cityName, c)) {
+            TRACE_SCOPE("serializeCityData", cityName, "http");
+            sent = SimpleServer::sendResponse(clientSock, ApiJson::cityData(engine, c), "application/json");
         }
         else {
-            SimpleServer::sendResponse(clientSock, "{}", "application/json");
+            sent = SimpleServer::sendResponse(clientSock, "{}", "application/json");
         }
     }
     else {
-        SimpleServer::sendResponse(clientSock, "404 Not Found", "text/plain");
+        sent = SimpleServer::sendResponse(clientSock, "404 Not Found", "text/plain", 404);
     }
 
     closesocket(clientSock);
+    Metrics::recordRequest(route, logCity, sent.status, sent.bytes, Metrics::nowMicros() - startMicros);
 }
 
 void initRealCities() {
@@ -266,6 +296,9 @@ void initRealCities() {
     engine.addRoute("Quetta", "Hyderabad"); // Via Sukkur (logical)
     engine.addRoute("Quetta", "Peshawar"); // N50 (Long route, but valid for graph)
 
+    // Warm start: serve the last checkpointed readings while they refresh
+    Snapshot::loadInto(engine, "weather.snapshot");
+
     // Initial load to prevent empty state
     engine.updateCity("Topi");
 }
@@ -273,6 +306,8 @@ void initRealCities() {
 int main() {
     SimpleServer::initWinsock();
     initRealCities();
+    Metrics::AccessLog::instance().start("access.log");
+    Snapshot::startCheckpointer(engine, "weather.snapshot", chrono::seconds(30));
 
     SOCKET serverSock = socket(AF_INET, SOCK_STREAM, 0);
     sockaddr_in serverAddr;
@@ -284,13 +319,15 @@ int main() {
         cout << "Bind failed!" << endl;
         return 1;
     }
-    listen(serverSock, 10);
+    listen(serverSock, SOMAXCONN);
+
+    SimpleServer::WorkerPool pool(kWorkerThreads, kMaxQueuedConnections, kRequestBudget, handleClient);
 
     cout << "DSA Weather Server running on http://localhost:8080" << endl;
     while (true) {
         SOCKET clientSock = accept(serverSock, nullptr, nullptr);
         if (clientSock != INVALID_SOCKET) {
-            thread(handleClient, clientSock).detach();
+            if (!pool.submit(clientSock)) SimpleServer::WorkerPool::shed(clientSock);
         }
     }
     return 0;
@@ -12,6 +12,12 @@
 #include <sstream>
 #include <iostream>
 #include <vector>
+#include <cctype>
+#include <cstdlib>
+#include <chrono>
+#include <algorithm>
+#include "Metrics.hpp"
+#include "Tracing.hpp"
 
 // Link necessary libraries automatically
 #pragma comment(lib, "wininet.lib")
@@ -29,23 +35,35 @@ namespace SimpleServer {
         }
     }
 
-    inline std::string loadHtmlFile(const std::string& path) {
-        std::ifstream file(path);
-        if (!file.is_open()) return "<h1>404 - File Not Found</h1>";
-        std::stringstream buffer;
-        buffer << file.rdbuf();
-        return buffer.str();
+    // What was actually written for a request, for logging and metrics.
+    struct ResponseInfo {
+        int status = 0;
+        size_t bytes = 0;
+    };
+
+    inline const char* statusText(int status) {
+        switch (status) {
+        case 200: return "OK";
+        case 304: return "Not Modified";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 503: return "Service Unavailable";
+        default: return "Unknown";
+        }
     }
 
-    inline void sendResponse(SOCKET clientSock, const std::string& body, const std::string& contentType) {
-        std::string header = "HTTP/1.1 200 OK\r\n";
+    // extraHeaders, if given, must be complete "Name: value\r\n" lines.
+    inline ResponseInfo sendResponse(SOCKET clientSock, const std::string& body, const std::string& contentType, int status = 200, const std::string& extraHeaders = "") {
+        std::string header = "HTTP/1.1 " + std::to_string(status) + " " + statusText(status) + "\r\n";
         header += "Content-Type: " + contentType + "\r\n";
         header += "Access-Control-Allow-Origin: *\r\n";
         header += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+        header += extraHeaders;
         header += "Connection: close\r\n\r\n";
 
         send(clientSock, header.c_str(), (int)header.size(), 0);
         send(clientSock, body.c_str(), (int)body.size(), 0);
+        return { status, header.size() + body.size() };
     }
 
     inline std::string getQueryParam(const std::string& url, const std::string& key) {
@@ -57,12 +75,96 @@ namespace SimpleServer {
         return url.substr(valueStart, valueEnd - valueStart);
     }
 
-    // Real-Time Data Fetcher (HTTPS)
+    // Case-insensitive lookup of a request header; returns the trimmed value or "".
+    inline std::string getHeader(const std::string& request, const std::string& name) {
+        size_t lineStart = request.find("\r\n");
+        while (lineStart != std::string::npos) {
+            lineStart += 2;
+            size_t lineEnd = request.find("\r\n", lineStart);
+            if (lineEnd == std::string::npos) lineEnd = request.size();
+            if (lineEnd == lineStart) break; // blank line ends the header block
+
+            size_t colon = request.find(':', lineStart);
+            if (colon != std::string::npos && colon < lineEnd && colon - lineStart == name.size()) {
+                bool match = true;
+                for (size_t i = 0; i < name.size() && match; i++) {
+                    match = tolower((unsigned char)request[lineStart + i]) == tolower((unsigned char)name[i]);
+                }
+                if (match) {
+                    size_t valueStart = request.find_first_not_of(" \t", colon + 1);
+                    if (valueStart == std::string::npos || valueStart > lineEnd) return "";
+                    size_t valueEnd = request.find_last_not_of(" \t", lineEnd - 1);
+                    return request.substr(valueStart, valueEnd - valueStart + 1);
+                }
+            }
+            lineStart = lineEnd < request.size() ? lineEnd : std::string::npos;
+        }
+        return "";
+    }
+
+    // Base URL of the forecast API. WEATHER_UPSTREAM overrides it, e.g. to
+    // point the server at the recorded-payload stub used by the benchmarks.
+    inline const std::string& upstreamBaseUrl() {
+        static const std::string base = []() {
+            const char* env = getenv("WEATHER_UPSTREAM");
+            return std::string(env && *env ? env : "https://api.open-meteo.com");
+        }();
+        return base;
+    }
+
+    // --- REQUEST BUDGET ---
+
+    // Deadline of the request the current thread is serving. Worker threads
+    // set it before handling a client; upstream fetches read it to bound
+    // their timeouts. Threads outside a request (background refreshes) have
+    // no budget and use kDefaultUpstreamTimeoutMs.
+    struct RequestBudget {
+        bool active = false;
+        bool degraded = false; // server under pressure: prefer cached data
+        std::chrono::steady_clock::time_point deadline;
+    };
+
+    static const int kDefaultUpstreamTimeoutMs = 10000;
+    static const int kMinUpstreamBudgetMs = 250;
+
+    inline RequestBudget& currentBudget() {
+        static thread_local RequestBudget budget;
+        return budget;
+    }
+
+    inline int remainingBudgetMs() {
+        const RequestBudget& budget = currentBudget();
+        if (!budget.active) return kDefaultUpstreamTimeoutMs;
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(budget.deadline - std::chrono::steady_clock::now()).count();
+        return (int)std::max<long long>(0, std::min<long long>(left, kDefaultUpstreamTimeoutMs));
+    }
+
+    // True when the current request should be answered from cache rather
+    // than wait on the upstream.
+    inline bool shouldAvoidUpstream() {
+        const RequestBudget& budget = currentBudget();
+        return budget.active && (budget.degraded || remainingBudgetMs() < kMinUpstreamBudgetMs);
+    }
+
+    // Real-Time Data Fetcher (HTTPS, or plain HTTP for a local upstream).
+    // Gives up with "" once the calling request's deadline has passed.
     inline std::string fetchURL(const std::string& url) {
+        TRACE_SCOPE("fetchURL", url, "upstream");
+        DWORD timeoutMs = (DWORD)remainingBudgetMs();
+        if (timeoutMs == 0) {
+            Metrics::registry().deadlineExceeded.fetch_add(1, std::memory_order_relaxed);
+            return "";
+        }
+
         HINTERNET hInternet = InternetOpenA("WeatherApp/1.0", INTERNET_OPEN_TYPE_DIRECT, NULL, NULL, 0);
         if (!hInternet) return "";
+        InternetSetOptionA(hInternet, INTERNET_OPTION_CONNECT_TIMEOUT, &timeoutMs, sizeof(timeoutMs));
+        InternetSetOptionA(hInternet, INTERNET_OPTION_SEND_TIMEOUT, &timeoutMs, sizeof(timeoutMs));
+        InternetSetOptionA(hInternet, INTERNET_OPTION_RECEIVE_TIMEOUT, &timeoutMs, sizeof(timeoutMs));
 
-        HINTERNET hConnect = InternetOpenUrlA(hInternet, url.c_str(), NULL, 0, INTERNET_FLAG_RELOAD | INTERNET_FLAG_SECURE, 0);
+        DWORD flags = INTERNET_FLAG_RELOAD;
+        if (url.compare(0, 8, "https://") == 0) flags |= INTERNET_FLAG_SECURE;
+        HINTERNET hConnect = InternetOpenUrlA(hInternet, url.c_str(), NULL, 0, flags, 0);
         if (!hConnect) {
             InternetCloseHandle(hInternet);
             return "";
@@ -74,6 +176,11 @@ namespace SimpleServer {
 
         while (InternetReadFile(hConnect, buffer, sizeof(buffer), &bytesRead) && bytesRead > 0) {
             response.append(buffer, bytesRead);
+            if (currentBudget().active && remainingBudgetMs() == 0) {
+                Metrics::registry().deadlineExceeded.fetch_add(1, std::memory_order_relaxed);
+                response.clear();
+                break;
+            }
         }
 
         InternetCloseHandle(hConnect);